@@ -29,10 +29,14 @@
 #include "Queue/ngx_queue.h"
 #include "Queue/ngx_radix_tree.h"
 #include "Queue/ngx_rbtree.h"
+#include "Queue/mpsc_queue.h"
+#include "object_pool.h"
+#include "buffer_pool.h"
 
 typedef ngx_rbtree_key_t      ngx_msec_t;
 typedef ngx_rbtree_key_int_t  ngx_msec_int_t;
 
 #include "ngx_string.h"
+#include "ngx_palloc.h"
 
 #endif
@@ -0,0 +1,75 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <stddef.h>
+
+#if defined(_MSC_VER)
+#include <Windows.h>
+#endif
+
+//多生产者单消费者的无锁队列,节点由调用者嵌入自己的结构中,不分配内存
+//生产者CAS压到头部,消费者一次交换取走整条链,再反转成先进先出
+
+typedef struct mpsc_node_s{
+	struct mpsc_node_s * next;
+}mpsc_node_t;
+
+typedef struct mpsc_queue_s{
+	mpsc_node_t * volatile head;
+}mpsc_queue_t;
+
+#if defined(_MSC_VER)
+#define mpsc_load(p)				(*(p))
+#define mpsc_exchange(p,v)			((mpsc_node_t*)InterlockedExchangePointer((PVOID volatile*)(p),(v)))
+#define mpsc_cas(p,o,n)				(InterlockedCompareExchangePointer((PVOID volatile*)(p),(n),(o)) == (PVOID)(o))
+#else
+#define mpsc_load(p)				__atomic_load_n(p,__ATOMIC_RELAXED)
+#define mpsc_exchange(p,v)			__atomic_exchange_n(p,v,__ATOMIC_ACQUIRE)
+#define mpsc_cas(p,o,n)				__atomic_compare_exchange_n(p,&(o),n,1,__ATOMIC_RELEASE,__ATOMIC_RELAXED)
+#endif
+
+#define mpsc_queue_empty(q)		(mpsc_load(&(q)->head) == NULL)
+
+static inline void mpsc_queue_init(mpsc_queue_t * q)
+{
+	q->head = NULL;
+}
+
+//返回1表示入队前队列为空,可以用来合并唤醒
+static inline int mpsc_queue_push(mpsc_queue_t * q,mpsc_node_t * node)
+{
+	mpsc_node_t * head = mpsc_load(&q->head);
+	while(1)
+	{
+		node->next = head;
+		if(mpsc_cas(&q->head,head,node))
+		{
+			break;
+		}
+#if defined(_MSC_VER)
+		head = mpsc_load(&q->head);
+#endif
+	}
+	return head == NULL;
+}
+
+//只能由消费者线程调用,返回按入队顺序排列的链表
+static inline mpsc_node_t * mpsc_queue_take(mpsc_queue_t * q)
+{
+	if(mpsc_queue_empty(q))
+	{
+		return NULL;
+	}
+	mpsc_node_t * node = mpsc_exchange(&q->head,NULL);
+	mpsc_node_t * list = NULL;
+	while(node != NULL)
+	{
+		mpsc_node_t * next = node->next;
+		node->next = list;
+		list = node;
+		node = next;
+	}
+	return list;
+}
+
+#endif
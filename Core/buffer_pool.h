@@ -0,0 +1,101 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdint.h>
+#include "log.h"
+#include "memory_util.h"
+
+//按大小分级的收发缓冲区池,只在所属线程使用
+//连接有数据在途时借用,数据发完就还回来,空闲连接不占缓冲区
+//每级缓存的空闲缓冲区有上限,超出的直接释放
+
+#define BUFFER_CLASS_SHIFT 12		//最小一级4K
+#define BUFFER_CLASS_COUNT 3		//4K 16K 64K
+#define BUFFER_POOL_CACHE (1024*1024)	//每级最多缓存的空闲字节数
+
+#define buffer_class_size(cls) ((size_t)1 << (BUFFER_CLASS_SHIFT + 2 * (cls)))
+
+typedef struct buffer_node_s{
+	struct buffer_node_s * next;
+}buffer_node_t;
+
+typedef struct buffer_class_s{
+	buffer_node_t * free;
+	uint32_t cached;		//free链表长度
+	uint32_t used;			//借出未还的数量
+}buffer_class_t;
+
+typedef struct buffer_pool_s{
+	buffer_class_t classes[BUFFER_CLASS_COUNT];
+}buffer_pool_t;
+
+//能放下size字节的最小一级,超过最大一级时返回最大一级
+static inline int buffer_class_fit(size_t size)
+{
+	int cls = 0;
+	while(cls < BUFFER_CLASS_COUNT - 1 && buffer_class_size(cls) < size)
+	{
+		cls++;
+	}
+	return cls;
+}
+
+static inline void buffer_pool_init(buffer_pool_t * pool)
+{
+	MEMZERO(pool,sizeof(buffer_pool_t));
+}
+
+//内存不足时返回NULL
+static inline void * buffer_pool_alloc(buffer_pool_t * pool,int cls)
+{
+	ASSERT(cls >= 0 && cls < BUFFER_CLASS_COUNT);
+	buffer_class_t * c = &pool->classes[cls];
+	void * ptr = c->free;
+	if(ptr != NULL)
+	{
+		c->free = c->free->next;
+		c->cached--;
+	}else{
+		ptr = MALLOC_TAG(MEM_TAG_BUFFER,buffer_class_size(cls));
+		if(ptr == NULL)
+		{
+			return NULL;
+		}
+	}
+	c->used++;
+	return ptr;
+}
+
+static inline void buffer_pool_free(buffer_pool_t * pool,int cls,void * ptr)
+{
+	ASSERT(cls >= 0 && cls < BUFFER_CLASS_COUNT);
+	buffer_class_t * c = &pool->classes[cls];
+	c->used--;
+	if((c->cached + 1) * buffer_class_size(cls) > BUFFER_POOL_CACHE)
+	{
+		FREE(ptr);
+		return;
+	}
+	buffer_node_t * node = (buffer_node_t*)ptr;
+	node->next = c->free;
+	c->free = node;
+	c->cached++;
+}
+
+//释放缓存的空闲缓冲区,借出的由借用方负责
+static inline void buffer_pool_done(buffer_pool_t * pool)
+{
+	for(int i = 0;i < BUFFER_CLASS_COUNT;i++)
+	{
+		buffer_class_t * c = &pool->classes[i];
+		while(c->free != NULL)
+		{
+			buffer_node_t * node = c->free;
+			c->free = node->next;
+			FREE(node);
+		}
+		c->cached = 0;
+	}
+}
+
+#endif
@@ -0,0 +1,162 @@
+#include "memory_util.h"
+#include "Queue/mpsc_queue.h"
+
+const char * mem_tag_name(int tag)
+{
+	static const char * names[MEM_TAG_COUNT] = {"other","cycle","event","connection","message","action","buffer","pool"};
+	return tag >= 0 && tag < MEM_TAG_COUNT ? names[tag] : "unknown";
+}
+
+#if defined(NGX_MEM_STAT)
+
+#if defined(_MSC_VER)
+#define MEM_THREAD_LOCAL __declspec(thread)
+#else
+#define MEM_THREAD_LOCAL __thread
+#endif
+
+//每块前面放16字节的头,记录大小和标签,保持16字节对齐
+#define MEM_HEADER_SIZE 16
+
+typedef struct mem_header_s{
+	size_t size;
+	uint32_t tag;
+}mem_header_t;
+
+//每个线程第一次分配时注册,线程退出后保留,统计一直有效
+typedef struct mem_thread_s{
+	mpsc_node_t node;
+	mem_stat_t stat;
+}mem_thread_t;
+
+static mpsc_queue_t g_mem_threads;
+static MEM_THREAD_LOCAL mem_thread_t * g_mem_local = NULL;
+
+static mem_stat_t * mem_stat_local()
+{
+	if(g_mem_local == NULL)
+	{
+		//统计块本身不计入
+		g_mem_local = (mem_thread_t*)calloc(1,sizeof(mem_thread_t));
+		if(g_mem_local == NULL)
+		{
+			return NULL;
+		}
+		mpsc_queue_push(&g_mem_threads,&g_mem_local->node);
+	}
+	return &g_mem_local->stat;
+}
+
+void mem_stat_add(int tag,size_t size)
+{
+	mem_stat_t * stat = mem_stat_local();
+	if(stat == NULL) return;
+	mem_tag_stat_t * t = &stat->tags[tag];
+	t->bytes += size;
+	t->allocs++;
+	if(t->bytes > t->peak) t->peak = t->bytes;
+}
+
+void mem_stat_sub(int tag,size_t size)
+{
+	mem_stat_t * stat = mem_stat_local();
+	if(stat == NULL) return;
+	mem_tag_stat_t * t = &stat->tags[tag];
+	t->bytes -= size;
+	t->frees++;
+}
+
+static void * mem_header_init(void * block,int tag,size_t size)
+{
+	mem_header_t * header = (mem_header_t*)block;
+	header->size = size;
+	header->tag = tag;
+	mem_stat_add(tag,size);
+	return (char*)block + MEM_HEADER_SIZE;
+}
+
+void * mem_alloc(int tag,size_t size)
+{
+	void * block = malloc(size + MEM_HEADER_SIZE);
+	if(block == NULL)
+	{
+		return NULL;
+	}
+	return mem_header_init(block,tag,size);
+}
+
+void * mem_calloc(int tag,size_t n,size_t size)
+{
+	void * block = calloc(1,n * size + MEM_HEADER_SIZE);
+	if(block == NULL)
+	{
+		return NULL;
+	}
+	return mem_header_init(block,tag,n * size);
+}
+
+void * mem_realloc(int tag,void * ptr,size_t size)
+{
+	if(ptr == NULL)
+	{
+		return mem_alloc(tag,size);
+	}
+	mem_header_t * header = (mem_header_t*)((char*)ptr - MEM_HEADER_SIZE);
+	int old_tag = header->tag;
+	size_t old_size = header->size;
+	void * block = realloc(header,size + MEM_HEADER_SIZE);
+	if(block == NULL)
+	{
+		return NULL;
+	}
+	mem_stat_sub(old_tag,old_size);
+	return mem_header_init(block,tag,size);
+}
+
+void mem_free(void * ptr)
+{
+	if(ptr == NULL)
+	{
+		return;
+	}
+	mem_header_t * header = (mem_header_t*)((char*)ptr - MEM_HEADER_SIZE);
+	mem_stat_sub(header->tag,header->size);
+	free(header);
+}
+
+//读其他线程的计数不加锁,64位计数在对齐时读写是原子的,合计只是近似的瞬时值
+//total中的peak是各线程峰值之和,只是上界
+int mem_stat_snapshot(mem_stat_t * threads,int max,mem_stat_t * total)
+{
+	int count = 0;
+	if(total != NULL)
+	{
+		MEMZERO(total,sizeof(mem_stat_t));
+	}
+	mpsc_node_t * node = mpsc_load(&g_mem_threads.head);
+	while(node != NULL)
+	{
+		mem_thread_t * thread = (mem_thread_t*)node;
+		mem_stat_t stat;
+		memcpy(&stat,(const void*)&thread->stat,sizeof(mem_stat_t));
+		if(threads != NULL && count < max)
+		{
+			threads[count] = stat;
+		}
+		if(total != NULL)
+		{
+			for(int i = 0;i < MEM_TAG_COUNT;i++)
+			{
+				total->tags[i].bytes += stat.tags[i].bytes;
+				total->tags[i].peak += stat.tags[i].peak;
+				total->tags[i].allocs += stat.tags[i].allocs;
+				total->tags[i].frees += stat.tags[i].frees;
+			}
+		}
+		count++;
+		node = mpsc_load(&node->next);
+	}
+	return count;
+}
+
+#endif
@@ -3,11 +3,68 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+//分配按模块打标签,-DNGX_MEM_STAT 时统计每个线程各模块的内存,默认直接用libc
+enum{
+	MEM_TAG_OTHER = 0,
+	MEM_TAG_CYCLE,			//cycle_t 及其他全局结构
+	MEM_TAG_EVENT,			//event_t
+	MEM_TAG_CONNECTION,		//connection_t
+	MEM_TAG_MESSAGE,		//跨线程投递的safe_event_t
+	MEM_TAG_ACTION,			//事件模块的数组,如pollfd、epoll_event
+	MEM_TAG_BUFFER,			//收发缓冲区
+	MEM_TAG_POOL,			//ngx_pool_t
+	MEM_TAG_COUNT
+};
+
+const char * mem_tag_name(int tag);
+
+#if defined(NGX_MEM_STAT)
+
+typedef struct mem_tag_stat_s{
+	int64_t bytes;			//当前占用,其他线程释放时记在释放线程上,可能为负
+	int64_t peak;			//本线程bytes的最大值
+	uint64_t allocs;
+	uint64_t frees;
+}mem_tag_stat_t;
+
+typedef struct mem_stat_s{
+	mem_tag_stat_t tags[MEM_TAG_COUNT];
+}mem_stat_t;
+
+void * mem_alloc(int tag,size_t size);
+void * mem_calloc(int tag,size_t n,size_t size);
+void * mem_realloc(int tag,void * ptr,size_t size);
+void mem_free(void * ptr);
+
+//不经过mem_alloc分配的内存,如对齐分配,由调用者自己记账
+void mem_stat_add(int tag,size_t size);
+void mem_stat_sub(int tag,size_t size);
+
+//依次取各线程的统计,返回线程数,超过max的只计数不复制;total为所有线程的合计
+int mem_stat_snapshot(mem_stat_t * threads,int max,mem_stat_t * total);
+
+#define MALLOC(S) mem_alloc(MEM_TAG_OTHER,(S))
+#define FREE mem_free
+#define CALLOC(N,S) mem_calloc(MEM_TAG_OTHER,(N),(S))
+#define REALLOC(P,S) mem_realloc(MEM_TAG_OTHER,(P),(S))
+#define MALLOC_TAG(T,S) mem_alloc((T),(S))
+#define REALLOC_TAG(T,P,S) mem_realloc((T),(P),(S))
+
+#else
 
 #define MALLOC malloc
 #define FREE free
 #define CALLOC calloc
 #define REALLOC realloc
+#define MALLOC_TAG(T,S) malloc(S)
+#define REALLOC_TAG(T,P,S) realloc((P),(S))
+#define mem_stat_add(T,S)
+#define mem_stat_sub(T,S)
+
+#endif
+
 #define MEMSET memset
 #define MEMZERO(A,S) memset((A),0,(S))
 
@@ -0,0 +1,112 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <stdint.h>
+#include "log.h"
+#include "memory_util.h"
+#include "Queue/mpsc_queue.h"
+
+//定长对象池,按块分配,空闲对象串成链表复用
+//所属线程直接放回本地链表,其他线程释放时放到无锁的远程链表,分配时再收回
+//对象空闲时头部用作链表节点
+
+#define OBJECT_POOL_CHUNK 1024
+
+typedef struct object_chunk_s{
+	struct object_chunk_s * next;
+}object_chunk_t;
+
+typedef struct object_pool_s{
+	size_t size;			//第一次分配时确定
+	uint32_t chunk;			//每块对象数
+	uint32_t max;			//最多分配的对象数,0不限制
+	uint32_t count;			//已从块中切出的对象数
+	mpsc_node_t * free;
+	mpsc_queue_t remote;
+	object_chunk_t * chunks;
+	char * next;			//当前块中未切出的位置
+	uint32_t left;
+	int tag;				//内存统计的标签
+}object_pool_t;
+
+static inline void object_pool_init(object_pool_t * pool,uint32_t max)
+{
+	MEMZERO(pool,sizeof(object_pool_t));
+	pool->max = max;
+	pool->chunk = max > 0 ? min(max,OBJECT_POOL_CHUNK) : OBJECT_POOL_CHUNK;
+	pool->tag = MEM_TAG_OTHER;
+	mpsc_queue_init(&pool->remote);
+}
+
+//所属线程调用,超过上限或内存不足时返回NULL
+static inline void * object_pool_alloc(object_pool_t * pool,size_t size)
+{
+	ASSERT(pool->size == 0 || pool->size == size);
+	pool->size = max(size,sizeof(mpsc_node_t));
+	if(pool->free == NULL)
+	{
+		pool->free = mpsc_queue_take(&pool->remote);
+	}
+	if(pool->free != NULL)
+	{
+		mpsc_node_t * node = pool->free;
+		pool->free = node->next;
+		return node;
+	}
+	if(pool->left == 0)
+	{
+		if(pool->max > 0 && pool->count >= pool->max)
+		{
+			return NULL;
+		}
+		uint32_t n = pool->chunk;
+		if(pool->max > 0) n = min(n,pool->max - pool->count);
+		//块头后面对象按指针对齐
+		size_t head = (sizeof(object_chunk_t) + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+		object_chunk_t * chunk = (object_chunk_t*)MALLOC_TAG(pool->tag,head + pool->size * n);
+		if(chunk == NULL)
+		{
+			return NULL;
+		}
+		chunk->next = pool->chunks;
+		pool->chunks = chunk;
+		pool->next = (char*)chunk + head;
+		pool->left = n;
+	}
+	void * ptr = pool->next;
+	pool->next += pool->size;
+	pool->left--;
+	pool->count++;
+	return ptr;
+}
+
+//所属线程调用
+static inline void object_pool_free(object_pool_t * pool,void * ptr)
+{
+	mpsc_node_t * node = (mpsc_node_t*)ptr;
+	node->next = pool->free;
+	pool->free = node;
+}
+
+//其他线程调用
+static inline void object_pool_free_remote(object_pool_t * pool,void * ptr)
+{
+	mpsc_queue_push(&pool->remote,(mpsc_node_t*)ptr);
+}
+
+//释放全部块,之后池中的对象都不能再使用
+static inline void object_pool_done(object_pool_t * pool)
+{
+	while(pool->chunks != NULL)
+	{
+		object_chunk_t * chunk = pool->chunks;
+		pool->chunks = chunk->next;
+		FREE(chunk);
+	}
+	pool->free = NULL;
+	mpsc_queue_init(&pool->remote);
+	pool->count = 0;
+	pool->left = 0;
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "log.h"
+#include "memory_util.h"
 #include "socket_util.h"
 
 #ifdef _WIN32
@@ -195,6 +196,76 @@ int socket_linger(SOCKET socket,int onoff,int linger)
 	l.l_linger = linger;
     return setsockopt(socket, SOL_SOCKET, SO_LINGER,(const char *)&l, sizeof(struct linger));
 }
+int socket_reuseaddr(SOCKET socket,int onoff)
+{
+	return setsockopt(socket,SOL_SOCKET,SO_REUSEADDR,(const char *)&onoff,sizeof(onoff));
+}
+int socket_reuseport(SOCKET socket,int onoff)
+{
+#ifdef SO_REUSEPORT
+	return setsockopt(socket,SOL_SOCKET,SO_REUSEPORT,(const char *)&onoff,sizeof(onoff));
+#else
+	LOGE("SO_REUSEPORT not supported.\n");
+	return -1;
+#endif
+}
+SOCKET socket_accept(SOCKET socket,struct sockaddr * addr,socklen_t * len)
+{
+#if defined(__linux__) && defined(SOCK_NONBLOCK)
+	return accept4(socket,addr,len,SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+	SOCKET fd = accept(socket,addr,len);
+	if(fd != -1)
+	{
+		socket_nonblocking(fd);
+	}
+	return fd;
+#endif
+}
+int socket_readv(SOCKET socket,socket_iovec_t * iov,int count)
+{
+#ifdef _WIN32
+	DWORD bytes = 0;
+	DWORD flags = 0;
+	if(WSARecv(socket,iov,count,&bytes,&flags,NULL,NULL) != 0)
+	{
+		return -1;
+	}
+	return (int)bytes;
+#else
+	return readv(socket,iov,count);
+#endif
+}
+int socket_writev(SOCKET socket,socket_iovec_t * iov,int count)
+{
+#ifdef _WIN32
+	DWORD bytes = 0;
+	if(WSASend(socket,iov,count,&bytes,0,NULL,NULL) != 0)
+	{
+		return -1;
+	}
+	return (int)bytes;
+#else
+	return writev(socket,iov,count);
+#endif
+}
+int socket_sendv(SOCKET socket,socket_iovec_t * iov,int count,int flags)
+{
+#ifdef _WIN32
+	DWORD bytes = 0;
+	if(WSASend(socket,iov,count,&bytes,(DWORD)flags,NULL,NULL) != 0)
+	{
+		return -1;
+	}
+	return (int)bytes;
+#else
+	struct msghdr msg;
+	MEMZERO(&msg,sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+	return sendmsg(socket,&msg,flags);
+#endif
+}
 int socket_sendtimeout(SOCKET socket, int timeout)
 {
 	return setsockopt(socket,SOL_SOCKET,SO_SNDTIMEO,(const char *)&timeout,sizeof(timeout));
@@ -361,11 +432,18 @@ int socket_recvtimeout(SOCKET socket, int timeout)
 	return addr_ptr;
 }
 
- SOCKET socket_bind(const char * type,const char * addr)
+ SOCKET socket_bind_(const char * type,const char * addr,int reuseport)
 {
 	int Type = socket_type(type);
 	SOCKET s = socket_object(Type);
 	if(s == -1) return s;
+	//多个线程各自监听同一个地址,由内核分配连接
+	if(reuseport && socket_reuseport(s,1) != 0)
+	{
+		LOGE("reuseport (%s) errno:%d\n",addr,_ERRNO);
+		close(s);
+		return -1;
+	}
 	struct sockaddr* addr_ptr = socket_addr(Type,addr);
 	if(addr_ptr == NULL){
 		close(s);
@@ -383,6 +461,61 @@ int socket_recvtimeout(SOCKET socket, int timeout)
 	return s;
 }
 
+ SOCKET socket_bind(const char * type,const char * addr)
+{
+	return socket_bind_(type,addr,0);
+}
+
+ void socket_listen_conf_init(socket_listen_conf_t * conf)
+{
+	MEMZERO(conf,sizeof(socket_listen_conf_t));
+	conf->backlog = SOMAXCONN;
+}
+
+ SOCKET socket_listen(const char * type,const char * addr,const socket_listen_conf_t * conf)
+{
+	SOCKET s = socket_bind_(type,addr,conf->reuseport);
+	if(s == -1) return s;
+	//缓冲区大小要在listen之前设置,窗口缩放在握手时确定
+	if(conf->sendbuf > 0 && socket_sendbuf(s,conf->sendbuf) != 0)
+	{
+		LOGE("sendbuf (%s) %d errno:%d\n",addr,conf->sendbuf,_ERRNO);
+	}
+	if(conf->recvbuf > 0 && socket_recvbuf(s,conf->recvbuf) != 0)
+	{
+		LOGE("recvbuf (%s) %d errno:%d\n",addr,conf->recvbuf,_ERRNO);
+	}
+	if(conf->defer_accept > 0)
+	{
+#ifdef TCP_DEFER_ACCEPT
+		if(setsockopt(s,IPPROTO_TCP,TCP_DEFER_ACCEPT,(const char*)&conf->defer_accept,sizeof(int)) != 0)
+		{
+			LOGE("TCP_DEFER_ACCEPT (%s) errno:%d\n",addr,_ERRNO);
+		}
+#else
+		LOGD("TCP_DEFER_ACCEPT not supported.\n");
+#endif
+	}
+	if(conf->fastopen > 0)
+	{
+#ifdef TCP_FASTOPEN
+		if(setsockopt(s,IPPROTO_TCP,TCP_FASTOPEN,(const char*)&conf->fastopen,sizeof(int)) != 0)
+		{
+			LOGE("TCP_FASTOPEN (%s) errno:%d\n",addr,_ERRNO);
+		}
+#else
+		LOGD("TCP_FASTOPEN not supported.\n");
+#endif
+	}
+	if(listen(s,conf->backlog > 0 ? conf->backlog : SOMAXCONN) != 0)
+	{
+		LOGE("listen (%s) errno:%d\n",addr,_ERRNO);
+		close(s);
+		return -1;
+	}
+	return s;
+}
+
  SOCKET socket_connect(const char * type,const char * addr,int nonblocking)
 {
 	int Type = socket_type(type);
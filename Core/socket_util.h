@@ -24,6 +24,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 
 typedef int SOCKET;
 
@@ -41,6 +42,29 @@ int socket_sendtimeout(SOCKET socket, int timeout);
 int socket_recvtimeout(SOCKET socket, int timeout);
 int socket_sendbuf_size(SOCKET socket);
 int socket_recvbuf_size(SOCKET socket);
+int socket_reuseaddr(SOCKET socket,int onoff);
+int socket_reuseport(SOCKET socket,int onoff);
+//返回的socket已经是非阻塞的,Linux上用accept4省掉一次fcntl
+SOCKET socket_accept(SOCKET socket,struct sockaddr * addr,socklen_t * len);
+
+//分散读、集中写,一次系统调用处理多段内存
+#ifdef _WIN32
+typedef WSABUF socket_iovec_t;
+#define socket_iovec_set(iov,ptr,size) {(iov)->buf = (char*)(ptr);(iov)->len = (ULONG)(size);}
+#else
+typedef struct iovec socket_iovec_t;
+#define socket_iovec_set(iov,ptr,size) {(iov)->iov_base = (void*)(ptr);(iov)->iov_len = (size_t)(size);}
+#endif
+//返回值和recv/send一样
+int socket_readv(SOCKET socket,socket_iovec_t * iov,int count);
+int socket_writev(SOCKET socket,socket_iovec_t * iov,int count);
+//带send标记的集中写,不支持的标记为0
+#ifdef MSG_MORE
+#define SOCKET_MSG_MORE MSG_MORE
+#else
+#define SOCKET_MSG_MORE 0
+#endif
+int socket_sendv(SOCKET socket,socket_iovec_t * iov,int count,int flags);
 
 
 #ifndef _WIN32
@@ -67,7 +91,22 @@ int socket_type(const char * type);
 SOCKET socket_object(int Type);
 int socket_size(int Type);
 struct sockaddr* socket_addr(int Type,const char * addr);
+SOCKET socket_bind_(const char * type,const char * addr,int reuseport);
 SOCKET socket_bind(const char * type,const char * addr);
+
+//监听socket的参数,0表示保持系统默认
+typedef struct socket_listen_conf_s{
+	int backlog;			//listen队列长度,受net.core.somaxconn限制
+	int reuseport;			//多个socket监听同一地址,由内核分配连接
+	int defer_accept;		//TCP_DEFER_ACCEPT秒数,连接带着数据到达才唤醒accept
+	int fastopen;			//TCP_FASTOPEN队列长度,重连的客户端省掉一个往返
+	int sendbuf;			//accept出来的连接继承这两个大小
+	int recvbuf;
+}socket_listen_conf_t;
+
+void socket_listen_conf_init(socket_listen_conf_t * conf);
+//绑定、设置参数并开始监听;reuseport失败时返回-1,其他可选参数不支持时只记录日志
+SOCKET socket_listen(const char * type,const char * addr,const socket_listen_conf_t * conf);
 SOCKET socket_connect(const char * type,const char * addr,int nonblocking);
 
 #ifdef _WIN32
@@ -63,6 +63,30 @@ inline double time_secondd()
 	return (time / 1E6);
 }
 
+//单调时钟,纳秒
+inline uint64_t time_monotonic_nanosecond()
+{
+	LARGE_INTEGER tick;
+	LARGE_INTEGER timestamp;
+	QueryPerformanceFrequency(&tick);
+	QueryPerformanceCounter(&timestamp);
+	return (uint64_t)(timestamp.QuadPart / tick.QuadPart) * 1000000000 +
+		(uint64_t)(timestamp.QuadPart % tick.QuadPart) * 1000000000 / tick.QuadPart;
+}
+
+//当前线程占用的CPU时间,纳秒
+inline uint64_t time_thread_cpu_nanosecond()
+{
+	FILETIME create,exit,kernel,user;
+	if(!GetThreadTimes(GetCurrentThread(),&create,&exit,&kernel,&user))
+	{
+		return 0;
+	}
+	uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+	uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+	return (k + u) * 100;
+}
+
 #define sleep(A) Sleep(A/1000)
 
 //微秒
@@ -103,6 +127,20 @@ static inline uint64_t time_nanosecond(){
 	return ts.tv_sec*1000000000 + ts.tv_nsec;
 }
 
+//单调时钟,纳秒
+static inline uint64_t time_monotonic_nanosecond(){
+	struct timespec ts;
+	ABORTI(clock_gettime(CLOCK_MONOTONIC, &ts) == -1);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+//当前线程占用的CPU时间,纳秒
+static inline uint64_t time_thread_cpu_nanosecond(){
+	struct timespec ts;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) return 0;
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
 //微秒
 inline uint64_t time_microsecond(){
 	struct timeval tv;
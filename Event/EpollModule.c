@@ -12,7 +12,7 @@ void epoll_module_event_handler(event_t *ev);
 
 epoll_module_t * epoll_module_create(int concurrent)
 {
-	epoll_module_t *module = (epoll_module_t*)MALLOC(sizeof(epoll_module_t));
+	epoll_module_t *module = (epoll_module_t*)MALLOC_TAG(MEM_TAG_ACTION,sizeof(epoll_module_t));
 	module->handle = epoll_create(concurrent);
 	ABORTI(module->handle == -1);
 	// LOGD("epoll module %x\n",module);
@@ -20,19 +20,15 @@ epoll_module_t * epoll_module_create(int concurrent)
 	module->process->data = module;
 	module->process->handler = (event_handler_pt)epoll_module_event_handler;
 
-	module->max_events_count = concurrent;
 	module->events_count = 0;
-	module->events = NULL;
+	module->syscalls = 0;
+	event_batch_init(&module->batch,concurrent,sizeof(struct epoll_event));
 	return module;
 }
 
 int epoll_module_done(epoll_module_t * module)
 {
-	if(module->events != NULL)
-	{
-		FREE(module->events);
-		module->events = NULL;
-	}
+	event_batch_free(&module->batch);
 	if(module->process != NULL)
 	{
 		FREE(module->process);
@@ -50,31 +46,42 @@ int epoll_module_add(epoll_module_t * module,socket_t * so,int event, int flags)
 	eevent.events |= flags;
 	eevent.data.ptr = (void*)so;
 	// LOGD("epoll module:%x :%d socket:%d\n",module,module->handle,so->handle);
+	module->syscalls++;
 	return epoll_ctl(module->handle,EPOLL_CTL_ADD,so->handle,&eevent);
 }
 
 int epoll_module_del(epoll_module_t * module,socket_t * so)
 {
+	module->syscalls++;
 	return epoll_ctl(module->handle,EPOLL_CTL_DEL,so->handle,NULL);
 }
 
+int epoll_module_mod(epoll_module_t * module,socket_t * so,int event, int flags)
+{
+	struct epoll_event eevent = {0};
+	eevent.events  = event;
+	eevent.events |= flags;
+	eevent.data.ptr = (void*)so;
+	module->syscalls++;
+	return epoll_ctl(module->handle,EPOLL_CTL_MOD,so->handle,&eevent);
+}
+
 int epoll_module_process(epoll_module_t * module,int milliseconds)
 {
-	int events_count = module->max_events_count;
-	struct epoll_event *events_ptr = (struct epoll_event *)module->events;
+	struct epoll_event *events_ptr = (struct epoll_event *)event_batch_reserve(&module->batch);
 	if(events_ptr == NULL)
 	{
-		events_count = max(1,events_count);
-		events_ptr = (struct epoll_event*)MALLOC(sizeof(struct epoll_event)*events_count);
-		if(events_ptr == NULL)
-		{
-			ABORTI("memory not enough.\n");
-			return -1;
-		}
-		module->events = events_ptr;
+		ABORTL("memory not enough.\n");
+		return -1;
 	}
+	int events_count = module->batch.count;
 
+	module->syscalls++;
 	int n = epoll_wait(module->handle,events_ptr,events_count,milliseconds);
+	if(n >= 0)
+	{
+		event_batch_update(&module->batch,n);
+	}
 	if(n == 0)
 	{
 		return 0;
@@ -89,11 +96,16 @@ int epoll_module_process(epoll_module_t * module,int milliseconds)
 	return module->events_count ;
 }
 
+uint64_t epoll_module_syscalls(epoll_module_t * module)
+{
+	return module->syscalls;
+}
+
 void epoll_module_event_handler(event_t *ev)
 {
 	epoll_module_t * module = (epoll_module_t *)ev->data;
 	ASSERT(module != NULL);
-	struct epoll_event *events_ptr = (struct epoll_event *)module->events;
+	struct epoll_event *events_ptr = (struct epoll_event *)module->batch.events;
 	ASSERT(events_ptr != NULL);
 	for(int i = 0 ; i < module->events_count;i++)
 	{
@@ -106,6 +118,7 @@ void epoll_module_event_handler(event_t *ev)
 		if(events & EPOLLRDHUP)
 		{
 			LOGD("EPOLLRDHUP trigger.\n");
+			so->read->ready = 1;
 			so->read->handler(so->read);
 		}
 		else
@@ -116,7 +129,7 @@ void epoll_module_event_handler(event_t *ev)
 			so->error->handler(so->error);
 		}
 		else
-		if(events & EPOLLERR)
+		if((events & EPOLLERR) && !(events & (EPOLLIN | EPOLLOUT)))
 		{
 			LOGD("EPOLLERR trigger.\n");
 			so->error->handler(so->error);
@@ -129,6 +142,17 @@ void epoll_module_event_handler(event_t *ev)
 			so->error->handler(so->error);
 		}
 		else {
+			//错误队列里的通知(如零拷贝发送完成)和读写就绪可能一起到达,边缘触发下读写事件不能丢
+			//错误处理已经投递了关闭(connection_del/connection_remove)时不再处理读写
+			if(events & EPOLLERR)
+			{
+				LOGD("EPOLLERR trigger.\n");
+				so->error->handler(so->error);
+				if(so->error->posted)
+				{
+					continue;
+				}
+			}
 			int flags = 0;
 			if(events & EPOLLET)
 			{
@@ -141,11 +165,13 @@ void epoll_module_event_handler(event_t *ev)
 			if(events & EPOLLIN)
 			{
 				so->read->flags = flags;
+				so->read->ready = 1;
 				so->read->handler(so->read);
 			}
 			if(events & EPOLLOUT)
 			{
 				so->write->flags = flags;
+				so->write->ready = 1;
 				so->write->handler(so->write);
 			}
 		}
@@ -3,15 +3,17 @@
 
 #include "Socket.h"
 #include "Event.h"
+#include "EventBatch.h"
 
 typedef struct epoll_module_s
 {
 	int handle;
 	event_t * process;
 
-	int max_events_count;
 	int events_count;
-	void * events;
+	event_batch_t batch;
+	//发起的系统调用数(等待和注册),bench用来对比各模块
+	uint64_t syscalls;
 }epoll_module_t;
 
 #ifdef __linux__
@@ -35,7 +37,9 @@ epoll_module_t * epoll_module_create(int concurrent);
 int epoll_module_done(epoll_module_t * module);
 int epoll_module_add(epoll_module_t * module,socket_t * so,int event, int flags);
 int epoll_module_del(epoll_module_t * module,socket_t * so);
+int epoll_module_mod(epoll_module_t * module,socket_t * so,int event, int flags);
 int epoll_module_process(epoll_module_t * module,int milliseconds);
+uint64_t epoll_module_syscalls(epoll_module_t * module);
 
 #endif
 
@@ -17,8 +17,21 @@ typedef struct event_s{
 	unsigned         timedout:1;
     unsigned         timer_set:1;
 	unsigned		 cancelable:1;
+	//事件模块报告就绪时置1,处理到EAGAIN时清0;边缘触发下没有清0之前不会再有通知
+	unsigned		 ready:1;
+	//定时器在时间轮中,否则在红黑树中
+	unsigned		 timer_wheel:1;
 
-	ngx_rbtree_node_t   timer;
+	union{
+		ngx_rbtree_node_t   timer;
+		//时间轮的节点,key与timer.key位置相同
+		struct{
+			ngx_rbtree_key_t key;
+			ngx_queue_t      queue;
+			uint16_t         slot;
+			uint8_t          level;
+		}wheel;
+	};
     ngx_queue_t      queue;
 }event_t;
 
@@ -43,7 +56,7 @@ static inline void event_init(event_t *event,event_handler_pt handler,void* data
 
 static inline event_t * event_create(event_handler_pt handler,void* data)
 {
-	event_t * event = MALLOC(sizeof(event_t));
+	event_t * event = MALLOC_TAG(MEM_TAG_EVENT,sizeof(event_t));
 	event_init(event,handler,data);
 	return event;
 }
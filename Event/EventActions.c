@@ -1,70 +1,233 @@
 #include "EventActions.h"
 
 typedef struct EventActionmodule{
+	const char * name;
+	int features;
 	void * (*create)(int concurrent);
 	int (*done)(void * module);
 	int (*add)(void * module,void * so,int event, int flags);
 	int (*del)(void * module,void * so);
+	int (*mod)(void * module,void * so,int event, int flags);
 	int (*process)(void * module,int milliseconds);
+	uint64_t (*syscalls)(void * module);
 }EventActionmodule;
 
 #if  (NGX_HAVE_EPOLL)
 static const EventActionmodule epoll_action = {
+	"epoll",
+	ACTION_FEATURE_ET,
 	epoll_module_create,
 	epoll_module_done,
 	epoll_module_add,
 	epoll_module_del,
-	epoll_module_process
+	epoll_module_mod,
+	epoll_module_process,
+	epoll_module_syscalls
+};
+#endif
+#if  (NGX_HAVE_IO_URING)
+//只用io_uring做就绪通知,系统调用数不比epoll少,也不支持边缘触发,需要时按名字指定
+static const EventActionmodule uring_action = {
+	"uring",
+	ACTION_FEATURE_EXPERIMENTAL,
+	uring_module_create,
+	uring_module_done,
+	uring_module_add,
+	uring_module_del,
+	uring_module_mod,
+	uring_module_process,
+	uring_module_syscalls
+};
+#endif
+#if  (NGX_HAVE_POLL)
+static const EventActionmodule poll_action = {
+	"poll",
+	0,
+	poll_module_create,
+	poll_module_done,
+	poll_module_add,
+	poll_module_del,
+	poll_module_mod,
+	poll_module_process,
+	poll_module_syscalls
 };
 #endif
 #if  (NGX_HAVE_KQUEUE)
 static const EventActionmodule kqueue_action = {
+	"kqueue",
+	0,
 	kqueue_module_create,
 	kqueue_module_done,
 	kqueue_module_add,
 	kqueue_module_del,
-	kqueue_module_process
+	kqueue_module_mod,
+	kqueue_module_process,
+	kqueue_module_syscalls
 };
 #endif
 #if  (NGX_HAVE_SELECT)
 static const EventActionmodule select_action = {
+	"select",
+	0,
 	select_module_create,
 	select_module_done,
 	select_module_add,
 	select_module_del,
-	select_module_process
+	select_module_mod,
+	select_module_process,
+	select_module_syscalls
 };
 #endif
 
+//自动选择时按顺序尝试,创建失败就用下一个
+static const EventActionmodule * action_modules[] = {
 #if  (NGX_HAVE_EPOLL)
-#define DEFAULT_ACTION_module epoll_action
-#elif (NGX_HAVE_KQUEUE)
-#define DEFAULT_ACTION_module kqueue_action
-#elif (NGX_HAVE_SELECT)
-#define DEFAULT_ACTION_module select_action
+	&epoll_action,
+#endif
+#if  (NGX_HAVE_IO_URING)
+	&uring_action,
+#endif
+#if  (NGX_HAVE_KQUEUE)
+	&kqueue_action,
+#endif
+#if  (NGX_HAVE_POLL)
+	&poll_action,
+#endif
+#if  (NGX_HAVE_SELECT)
+	&select_action,
 #endif
+	NULL
+};
+
+struct core_s{
+	const EventActionmodule * action;
+	void * module;
+};
+
+static const EventActionmodule * action_selected = NULL;
+
+static const EventActionmodule * action_find(const char * name)
+{
+	for(int i = 0;action_modules[i] != NULL;i++)
+	{
+		if(strcmp(action_modules[i]->name,name) == 0)
+		{
+			return action_modules[i];
+		}
+	}
+	return NULL;
+}
+
+int action_select(const char * name)
+{
+	if(name == NULL || *name == 0 || strcmp(name,ACTION_MODULE_AUTO) == 0)
+	{
+		action_selected = NULL;
+		return 0;
+	}
+	const EventActionmodule * action = action_find(name);
+	if(action == NULL)
+	{
+		LOGE("unknown event module:%s\n",name);
+		return -1;
+	}
+	action_selected = action;
+	return 0;
+}
+
+const char * action_module_name(int index)
+{
+	int count = sizeof(action_modules)/sizeof(action_modules[0]) - 1;
+	if(index < 0 || index >= count)
+	{
+		return NULL;
+	}
+	return action_modules[index]->name;
+}
+
+const char * action_name(core_t * core)
+{
+	return core->action->name;
+}
+
+int action_features(core_t * core)
+{
+	return core->action->features;
+}
 
 core_t * action_create(int concurrent)
 {
-	return DEFAULT_ACTION_module.create(concurrent);
+	const EventActionmodule * action = action_selected;
+	if(action == NULL)
+	{
+		const char * name = getenv(ACTION_MODULE_ENV);
+		if(name != NULL && *name != 0 && strcmp(name,ACTION_MODULE_AUTO) != 0)
+		{
+			action = action_find(name);
+			if(action == NULL)
+			{
+				LOGE("unknown event module %s=%s\n",ACTION_MODULE_ENV,name);
+			}
+		}
+	}
+
+	void * module = NULL;
+	if(action != NULL)
+	{
+		if(action->features & ACTION_FEATURE_EXPERIMENTAL)
+		{
+			LOGI("event module %s is experimental.\n",action->name);
+		}
+		module = action->create(concurrent);
+	}else{
+		for(int i = 0;action_modules[i] != NULL && module == NULL;i++)
+		{
+			action = action_modules[i];
+			if(action->features & ACTION_FEATURE_EXPERIMENTAL)
+			{
+				continue;
+			}
+			module = action->create(concurrent);
+		}
+	}
+	if(module == NULL)
+	{
+		return NULL;
+	}
+	core_t * core = (core_t*)MALLOC(sizeof(core_t));
+	core->action = action;
+	core->module = module;
+	return core;
+}
+
+int action_done(core_t * core)
+{
+	int ret = core->action->done(core->module);
+	FREE(core);
+	return ret;
+}
+
+int action_add(core_t * core,socket_t * so,int event, int flags)
+{
+	return core->action->add(core->module,so,event,flags);
 }
 
-int action_done(core_t * module)
+int action_del(core_t * core,socket_t * so)
 {
-	return DEFAULT_ACTION_module.done(module);
+	return core->action->del(core->module,so);
 }
 
-int action_add(core_t * module,socket_t * so,int event, int flags)
+int action_mod(core_t * core,socket_t * so,int event, int flags)
 {
-	return DEFAULT_ACTION_module.add(module,so,event,flags);
+	return core->action->mod(core->module,so,event,flags);
 }
 
-int action_del(core_t * module,socket_t * so)
+int action_process(core_t * core,int milliseconds)
 {
-	return DEFAULT_ACTION_module.del(module,so);
+	return core->action->process(core->module,milliseconds);
 }
 
-int action_process(core_t * module,int milliseconds)
+uint64_t action_syscalls(core_t * core)
 {
-	return DEFAULT_ACTION_module.process(module,milliseconds);
+	return core->action->syscalls(core->module);
 }
@@ -3,15 +3,35 @@
 
 #include "Socket.h"
 #include "EpollModule.h"
+#include "UringModule.h"
+#include "PollModule.h"
 #include "KqueueModule.h"
 #include "SelectModule.h"
 
 typedef struct core_s core_t;
 
+//启动时通过 action_select 或者环境变量选择事件模块,auto 按 epoll/kqueue/poll/select 顺序尝试,跳过实验性模块(uring)
+#define ACTION_MODULE_ENV "EVENT_MODULE"
+#define ACTION_MODULE_AUTO "auto"
+
+int action_select(const char * name);
+const char * action_module_name(int index);
+const char * action_name(core_t * core);
+
+//模块支持边缘触发(NGX_FLAGS_ET),其他模块忽略该标记按水平触发处理
+#define ACTION_FEATURE_ET 0x1
+//实验性模块,auto不会选择,只能通过 action_select 或环境变量按名字指定
+#define ACTION_FEATURE_EXPERIMENTAL 0x2
+int action_features(core_t * core);
+
 core_t * action_create(int concurrent);
 int action_done(core_t * core);
 int action_add(core_t * core,socket_t * obj,int event, int flags);
 int action_del(core_t * core,socket_t * obj);
+//修改已注册socket关注的事件,例如发送缓冲区满时加上写事件
+int action_mod(core_t * core,socket_t * obj,int event, int flags);
 int action_process(core_t * core,int milliseconds);
+//事件模块自己发起的系统调用数(等待、注册、修改),不含收发数据
+uint64_t action_syscalls(core_t * core);
 
 #endif
@@ -0,0 +1,88 @@
+#ifndef EVENT_BATCH_H
+#define EVENT_BATCH_H
+
+#include "../Core/core.h"
+
+//epoll_wait/kevent 一次取回的事件数组,按实际就绪数量伸缩
+//满了就翻倍,连续多轮不到1/4就减半,保持数组常驻缓存
+
+#define EVENT_BATCH_MIN 64
+#define EVENT_BATCH_MAX 4096
+#define EVENT_BATCH_SHRINK_TICKS 128
+
+typedef struct event_batch_s
+{
+	int min_count;
+	int max_count;
+	int count;		//下一次等待使用的数量
+	int size;		//已分配的数量
+	int idle;
+	size_t elem;
+	void * events;
+}event_batch_t;
+
+static inline void event_batch_init(event_batch_t * batch,int concurrent,size_t elem)
+{
+	batch->max_count = max(1,min(concurrent,EVENT_BATCH_MAX));
+	batch->min_count = min(EVENT_BATCH_MIN,batch->max_count);
+	batch->count = batch->min_count;
+	batch->size = 0;
+	batch->idle = 0;
+	batch->elem = elem;
+	batch->events = NULL;
+}
+
+static inline void * event_batch_reserve(event_batch_t * batch)
+{
+	if(batch->events == NULL || batch->size != batch->count)
+	{
+		void * events = REALLOC_TAG(MEM_TAG_ACTION,batch->events,batch->elem * batch->count);
+		if(events == NULL)
+		{
+			//扩容失败时继续用旧数组
+			if(batch->events == NULL) return NULL;
+			batch->count = batch->size;
+			return batch->events;
+		}
+		batch->events = events;
+		batch->size = batch->count;
+	}
+	return batch->events;
+}
+
+//根据本轮就绪数量调整下一轮的大小
+static inline void event_batch_update(event_batch_t * batch,int n)
+{
+	if(n >= batch->count)
+	{
+		batch->idle = 0;
+		if(batch->count < batch->max_count)
+		{
+			batch->count = min(batch->count * 2,batch->max_count);
+		}
+	}
+	else if(n <= batch->count / 4 && batch->count > batch->min_count)
+	{
+		if(++batch->idle >= EVENT_BATCH_SHRINK_TICKS)
+		{
+			batch->idle = 0;
+			batch->count = max(batch->count / 2,batch->min_count);
+		}
+	}
+	else
+	{
+		batch->idle = 0;
+	}
+}
+
+static inline void event_batch_free(event_batch_t * batch)
+{
+	if(batch->events != NULL)
+	{
+		FREE(batch->events);
+		batch->events = NULL;
+	}
+	batch->size = 0;
+}
+
+#endif
@@ -14,26 +14,22 @@ void kqueue_module_event_handler(event_t *ev);
 
 kqueue_module_t * kqueue_module_create(int concurrent)
 {
-	kqueue_module_t *module =  (kqueue_module_t*)MALLOC(sizeof(kqueue_module_t));
+	kqueue_module_t *module =  (kqueue_module_t*)MALLOC_TAG(MEM_TAG_ACTION,sizeof(kqueue_module_t));
 	module->handle = kqueue();
 
 	module->process = (event_t*)MALLOC(sizeof(event_t));
 	module->process->data = module;
 	module->process->handler = (event_handler_pt)kqueue_module_event_handler;
 
-	module->max_events_count = concurrent;
 	module->events_count = 0;
-	module->events = NULL;
+	module->syscalls = 0;
+	event_batch_init(&module->batch,concurrent,sizeof(struct kevent));
 	return module;
 }
 
 int kqueue_module_done(kqueue_module_t * module)
 {
-	if(module->events != NULL)
-	{
-		FREE(module->events);
-		module->events = NULL;
-	}
+	event_batch_free(&module->batch);
 	if(module->process != NULL)
 	{
 		FREE(module->process);
@@ -54,36 +50,51 @@ int kqueue_module_del(kqueue_module_t * module,socket_t * so)
 	return kqueue_module_set(module,so,EVFILT_READ,EV_DELETE|EV_DISABLE);
 }
 
+//kqueue按过滤器注册,读一直保留(只在读暂停时禁用),写按需要添加或删除
+int kqueue_module_mod(kqueue_module_t * module,socket_t * so,int event, int flags)
+{
+	//过滤器是负数不能按位组合,去掉读以后剩下0
+	if(event == 0)
+	{
+		return kqueue_module_set(module,so,EVFILT_READ,EV_DISABLE);
+	}
+	kqueue_module_set(module,so,EVFILT_READ,EV_ENABLE);
+	if(event != NGX_READ_EVENT)
+	{
+		return kqueue_module_set(module,so,EVFILT_WRITE,EV_ADD|EV_ENABLE|flags);
+	}
+	kqueue_module_set(module,so,EVFILT_WRITE,EV_DELETE);
+	return 0;
+}
+
 int kqueue_module_set(kqueue_module_t * module,socket_t * so,int event, int flags)
 {
 	struct kevent ev;
     EV_SET(&ev, so->handle, event, flags, 0, 0, (void*)(intptr_t)so);
+	module->syscalls++;
 	int r = kevent(module->handle, &ev, 1, NULL, 0, NULL);
 	return r;
 }
 
 int kqueue_module_process(kqueue_module_t * module,int milliseconds)
 {
-	int events_count = module->max_events_count;
-	struct kevent *events_ptr = (struct kevent *)module->events;
-
+	struct kevent *events_ptr = (struct kevent *)event_batch_reserve(&module->batch);
 	if(events_ptr == NULL)
 	{
-		events_count = max(1,events_count);
-		events_ptr = (struct kevent*)MALLOC(sizeof(struct kevent)*events_count);
-		if(events_ptr == NULL)
-		{
-			ABORTL("memory not enough.");
-			return -1;
-		}
-
-		module->events = events_ptr;
+		ABORTL("memory not enough.");
+		return -1;
 	}
+	int events_count = module->batch.count;
 
 	struct timespec timeout_spec;
     timeout_spec.tv_sec = milliseconds / 1000;
     timeout_spec.tv_nsec = (milliseconds % 1000) * 1000 * 1000;
+	module->syscalls++;
 	int n = kevent(module->handle, NULL, 0, events_ptr, events_count, &timeout_spec);
+	if(n >= 0)
+	{
+		event_batch_update(&module->batch,n);
+	}
 	if(n == 0)
 	{
 		return 0;
@@ -98,11 +109,16 @@ int kqueue_module_process(kqueue_module_t * module,int milliseconds)
 	return module->events_count;
 }
 
+uint64_t kqueue_module_syscalls(kqueue_module_t * module)
+{
+	return module->syscalls;
+}
+
 void kqueue_module_event_handler(event_t *ev)
 {
 	kqueue_module_t * module = (kqueue_module_t *)ev->data;
 	ASSERT(module != NULL);
-	struct kevent *events_ptr = (struct kevent *)module->events;
+	struct kevent *events_ptr = (struct kevent *)module->batch.events;
 	ASSERT(events_ptr != NULL);
 	for(int i = 0 ; i < module->events_count;i++)
 	{
@@ -121,11 +137,11 @@ void kqueue_module_event_handler(event_t *ev)
 		}
 		else if(events & EVFILT_READ)
 		{
-			if(so->read != NULL) so->read->handler(so->read);
+			if(so->read != NULL) {so->read->ready = 1;so->read->handler(so->read);}
 		}
 		else if(events & EVFILT_WRITE)
 		{
-			if(so->write != NULL) so->write->handler(so->write);
+			if(so->write != NULL) {so->write->ready = 1;so->write->handler(so->write);}
 		}
 		else{
 			if(so->error != NULL) so->error->handler(so->error);
@@ -24,23 +24,27 @@
 
 #include "Socket.h"
 #include "Event.h"
+#include "EventBatch.h"
 
 typedef struct kqueue_module_s
 {
 	int handle;
 	event_t * process;
 
-	int max_events_count;
 	int events_count;
-	void * events;
+	event_batch_t batch;
+	//发起的系统调用数(等待和注册),bench用来对比各模块
+	uint64_t syscalls;
 }kqueue_module_t;
 
 kqueue_module_t * kqueue_module_create(int concurrent);
 int kqueue_module_done(kqueue_module_t * module);
 int kqueue_module_add(kqueue_module_t * module,socket_t * so,int event, int flags);
 int kqueue_module_del(kqueue_module_t * module,socket_t * so);
+int kqueue_module_mod(kqueue_module_t * module,socket_t * so,int event, int flags);
 int kqueue_module_set(kqueue_module_t * module,socket_t * so,int event, int flags);
 int kqueue_module_process(kqueue_module_t * module,int milliseconds);
+uint64_t kqueue_module_syscalls(kqueue_module_t * module);
 
 #endif
 
@@ -0,0 +1,231 @@
+#include "PollModule.h"
+
+#if (NGX_HAVE_POLL)
+
+#include <unistd.h>
+#include <signal.h>
+
+#define POLL_MIN_SIZE 1024
+
+void poll_module_event_handler(event_t *ev);
+
+poll_module_t * poll_module_create(int concurrent)
+{
+	poll_module_t *module = (poll_module_t*)MALLOC_TAG(MEM_TAG_ACTION,sizeof(poll_module_t));
+	MEMZERO(module,sizeof(poll_module_t));
+
+	//按需扩容,不按concurrent一次分配
+	module->fds_size = max(1,min(concurrent,POLL_MIN_SIZE));
+	module->fds_count = 0;
+	module->fds = (struct pollfd*)MALLOC_TAG(MEM_TAG_ACTION,sizeof(struct pollfd)*module->fds_size);
+	module->sockets = (socket_t**)MALLOC_TAG(MEM_TAG_ACTION,sizeof(socket_t*)*module->fds_size);
+
+	module->index_size = 0;
+	module->index = NULL;
+
+	module->process = (event_t*)MALLOC(sizeof(event_t));
+	module->process->data = module;
+	module->process->handler = (event_handler_pt)poll_module_event_handler;
+
+	module->events_count = 0;
+	return module;
+}
+
+int poll_module_done(poll_module_t * module)
+{
+	if(module->process != NULL)
+	{
+		FREE(module->process);
+		module->process = NULL;
+	}
+	FREE(module->fds);
+	FREE(module->sockets);
+	if(module->index != NULL)
+	{
+		FREE(module->index);
+		module->index = NULL;
+	}
+	FREE(module);
+	return 0;
+}
+
+static int poll_module_reserve(poll_module_t * module,int fd)
+{
+	if(module->fds_count >= module->fds_size)
+	{
+		int size = module->fds_size * 2;
+		struct pollfd *fds = (struct pollfd*)REALLOC_TAG(MEM_TAG_ACTION,module->fds,sizeof(struct pollfd)*size);
+		if(fds == NULL) return -1;
+		module->fds = fds;
+		socket_t **sockets = (socket_t**)REALLOC_TAG(MEM_TAG_ACTION,module->sockets,sizeof(socket_t*)*size);
+		if(sockets == NULL) return -1;
+		module->sockets = sockets;
+		module->fds_size = size;
+	}
+	if(fd >= module->index_size)
+	{
+		int size = max(POLL_MIN_SIZE,module->index_size);
+		while(size <= fd)
+		{
+			size *= 2;
+		}
+		int *index = (int*)REALLOC_TAG(MEM_TAG_ACTION,module->index,sizeof(int)*size);
+		if(index == NULL) return -1;
+		for(int i = module->index_size;i < size;i++)
+		{
+			index[i] = -1;
+		}
+		module->index = index;
+		module->index_size = size;
+	}
+	return 0;
+}
+
+int poll_module_add(poll_module_t * module,socket_t * so,int event, int flags)
+{
+	int fd = so->handle;
+	if(poll_module_reserve(module,fd) != 0)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+	if(module->index[fd] != -1)
+	{
+		errno = EEXIST;
+		return -1;
+	}
+	int i = module->fds_count++;
+	module->fds[i].fd = fd;
+	//poll只有水平触发,忽略ET/ONESHOT
+	module->fds[i].events = (short)(event | (flags & ~(NGX_FLAGS_ET | NGX_FLAGS_ONESHAOT)));
+	module->fds[i].revents = 0;
+	module->sockets[i] = so;
+	module->index[fd] = i;
+	return 0;
+}
+
+int poll_module_del(poll_module_t * module,socket_t * so)
+{
+	int fd = so->handle;
+	if(fd < 0 || fd >= module->index_size || module->index[fd] == -1)
+	{
+		errno = ENOENT;
+		return -1;
+	}
+	int i = module->index[fd];
+	int last = --module->fds_count;
+	if(i != last)
+	{
+		module->fds[i] = module->fds[last];
+		module->sockets[i] = module->sockets[last];
+		module->index[module->fds[i].fd] = i;
+	}
+	module->index[fd] = -1;
+	return 0;
+}
+
+int poll_module_mod(poll_module_t * module,socket_t * so,int event, int flags)
+{
+	int fd = so->handle;
+	if(fd < 0 || fd >= module->index_size || module->index[fd] == -1)
+	{
+		errno = ENOENT;
+		return -1;
+	}
+	int i = module->index[fd];
+	module->fds[i].events = (short)(event | (flags & ~(NGX_FLAGS_ET | NGX_FLAGS_ONESHAOT)));
+	return 0;
+}
+
+int poll_module_process(poll_module_t * module,int milliseconds)
+{
+	//负数表示一直等待,ppoll要传NULL
+	struct timespec ts;
+	ts.tv_sec = milliseconds / 1000;
+	ts.tv_nsec = (milliseconds % 1000) * 1000000;
+	module->syscalls++;
+	int n = ppoll(module->fds,module->fds_count,milliseconds < 0 ? NULL : &ts,NULL);
+	if(n == 0)
+	{
+		return 0;
+	}
+	else if(n < 0)
+	{
+		if(errno == EINTR) return 0;
+		LOGE("ppoll errno:%d\n",errno);
+		return -1;
+	}
+	module->events_count = n;
+	module->process->handler(module->process);
+	return n;
+}
+
+uint64_t poll_module_syscalls(poll_module_t * module)
+{
+	return module->syscalls;
+}
+
+void poll_module_event_handler(event_t *ev)
+{
+	poll_module_t * module = (poll_module_t *)ev->data;
+	ASSERT(module != NULL);
+	int count = module->events_count;
+	int i = 0;
+	while(i < module->fds_count && count > 0)
+	{
+		struct pollfd *pfd = &module->fds[i];
+		int events = pfd->revents;
+		if(events == 0)
+		{
+			i++;
+			continue;
+		}
+		int fd = pfd->fd;
+		pfd->revents = 0;
+		count--;
+		socket_t *so = module->sockets[i];
+
+#ifdef POLLRDHUP
+		if(events & POLLRDHUP)
+		{
+			LOGD("POLLRDHUP trigger.\n");
+			so->read->ready = 1;
+			so->read->handler(so->read);
+		}
+		else
+#endif
+		if(events & (POLLHUP | POLLERR | POLLNVAL))
+		{
+			LOGD("POLLHUP|POLLERR trigger.\n");
+			so->error->handler(so->error);
+		}
+		else
+		if(events & POLLPRI)
+		{
+			LOGD("POLLPRI trigger.\n");
+			//带外数据
+			so->error->handler(so->error);
+		}
+		else {
+			if(events & POLLIN)
+			{
+				so->read->flags = 0;
+				so->read->ready = 1;
+				so->read->handler(so->read);
+			}
+			if(events & POLLOUT)
+			{
+				so->write->flags = 0;
+				so->write->ready = 1;
+				so->write->handler(so->write);
+			}
+		}
+		//回调里删除时末尾元素被移到当前位置,需要重新检查
+		if(i < module->fds_count && module->fds[i].fd == fd)
+		{
+			i++;
+		}
+	}
+}
+
+#endif
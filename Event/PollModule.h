@@ -0,0 +1,47 @@
+#ifndef POLL_module_H
+#define POLL_module_H
+
+#include "Socket.h"
+#include "Event.h"
+
+#ifdef __linux__
+#define NGX_HAVE_POLL 1
+#endif
+
+#if (NGX_HAVE_POLL)
+
+#include <poll.h>
+
+//事件和标记定义与epoll保持一致
+#include "EpollModule.h"
+
+typedef struct poll_module_s
+{
+	event_t * process;
+
+	//紧凑的pollfd数组,删除时用末尾元素填补
+	int fds_count;
+	int fds_size;
+	struct pollfd *fds;
+	socket_t **sockets;
+
+	//fd -> fds下标
+	int index_size;
+	int *index;
+
+	int events_count;
+	//发起的系统调用数(注册只改数组,只有等待),bench用来对比各模块
+	uint64_t syscalls;
+}poll_module_t;
+
+poll_module_t * poll_module_create(int concurrent);
+int poll_module_done(poll_module_t * module);
+int poll_module_add(poll_module_t * module,socket_t * so,int event, int flags);
+int poll_module_del(poll_module_t * module,socket_t * so);
+int poll_module_mod(poll_module_t * module,socket_t * so,int event, int flags);
+int poll_module_process(poll_module_t * module,int milliseconds);
+uint64_t poll_module_syscalls(poll_module_t * module);
+
+#endif
+
+#endif
@@ -6,7 +6,7 @@ void select_module_event_handler(event_t *ev);
 
 select_module_t * select_module_create(int concurrent)
 {
-	select_module_t *module = (select_module_t*)MALLOC(sizeof(select_module_t));
+	select_module_t *module = (select_module_t*)MALLOC_TAG(MEM_TAG_ACTION,sizeof(select_module_t));
 	module->max_handle = 0;
 
 	FD_ZERO(&module->read_set_cache);
@@ -20,9 +20,16 @@ select_module_t * select_module_create(int concurrent)
 	module->concurrent = concurrent;
 	module->events_index = 0;
 	module->events_count = 0;
-	int size = sizeof(event_t*)*concurrent*3;
-	module->events = MALLOC(size);
+	module->syscalls = 0;
+	//select最多FD_SETSIZE个句柄,事件数组按需扩容
+	module->events_size = max(1,min(concurrent*3,FD_SETSIZE));
+	int size = sizeof(event_t*)*module->events_size;
+	module->events = MALLOC_TAG(MEM_TAG_ACTION,size);
 	MEMSET(module->events,0,size);
+	//event->data 由服务自己使用,不一定是socket
+	size = sizeof(socket_t*)*module->events_size;
+	module->sockets = MALLOC_TAG(MEM_TAG_ACTION,size);
+	MEMSET(module->sockets,0,size);
 
 	module->process = (event_t*)MALLOC(sizeof(event_t));
 	module->process->data = module;
@@ -42,101 +49,120 @@ int select_module_done(select_module_t * module)
 		FREE(module->events);
 		module->events = NULL;
 	}
+	if(module->sockets != NULL)
+	{
+		FREE(module->sockets);
+		module->sockets = NULL;
+	}
 	FREE(module);
 	return 0;
 }
 
-int select_module_add(select_module_t * module,socket_t * so,int event, int flags)
+static void select_module_set(select_module_t * module,fd_set * set,event_t * ev,socket_t * so)
 {
-	if((event & NGX_READ_EVENT) == NGX_READ_EVENT)
+	SOCKET handle = so->handle;
+	if(ev->index == EVENT_INVALID_INDEX)
 	{
-		if(so->read->index == EVENT_INVALID_INDEX)
+		if(module->events_index >= module->events_size)
 		{
-			FD_SET(so->handle, &module->read_set_cache);
-			module->events[module->events_index] = so->read;
-			so->read->index = module->events_index;
-			module->events_index++;
-		}else{
-			LOGE("select_module_add so->read->index:%d\n",so->read->index);
+			int size = module->events_size * 2;
+			event_t ** events = (event_t**)REALLOC_TAG(MEM_TAG_ACTION,module->events,sizeof(event_t*)*size);
+			ABORTI(events == NULL);
+			module->events = events;
+			socket_t ** sockets = (socket_t**)REALLOC_TAG(MEM_TAG_ACTION,module->sockets,sizeof(socket_t*)*size);
+			ABORTI(sockets == NULL);
+			module->sockets = sockets;
+			module->events_size = size;
 		}
+		FD_SET(handle, set);
+		module->events[module->events_index] = ev;
+		module->sockets[module->events_index] = so;
+		ev->index = module->events_index;
+		module->events_index++;
+	}else{
+		LOGE("select_module_add index:%d\n",ev->index);
 	}
-	if((event & NGX_WRITE_EVENT) == NGX_WRITE_EVENT)
+	if(module->max_handle <= handle)
 	{
-		if(so->write->index == EVENT_INVALID_INDEX)
-		{
-			FD_SET(so->handle, &module->write_set_cache);
-			module->events[module->events_index] = so->write;
-			so->write->index = module->events_index;
-			module->events_index++;
-		}else{
-			LOGE("select_module_add so->write->index:%d\n",so->write->index);
-		}
+		module->max_handle = handle;
 	}
-	if((event & NGX_ERROR_EVENT) == NGX_ERROR_EVENT)
+}
+
+static void select_module_clr(select_module_t * module,fd_set * set,event_t * ev,socket_t * so)
+{
+	if(ev->index != EVENT_INVALID_INDEX)
 	{
-		if(so->error->index == EVENT_INVALID_INDEX)
+		FD_CLR(so->handle, set);
+		int index = ev->index;
+		int last = module->events_index - 1;
+		ev->index = EVENT_INVALID_INDEX;
+		//用末尾的事件填补空位
+		if(index != last)
 		{
-			FD_SET(so->handle, &module->except_set_cache);
-			module->events[module->events_index] = so->error;
-			so->error->index = module->events_index;
-			module->events_index++;
-		}else{
-			LOGE("select_module_add so->error->index:%d\n",so->error->index);
+			module->events[index] = module->events[last];
+			module->sockets[index] = module->sockets[last];
+			module->events[index]->index = index;
 		}
+		module->events[last] = NULL;
+		module->sockets[last] = NULL;
+		module->events_index--;
+	}
+}
+
+int select_module_add(select_module_t * module,socket_t * so,int event, int flags)
+{
+	if((event & NGX_READ_EVENT) == NGX_READ_EVENT)
+	{
+		select_module_set(module,&module->read_set_cache,so->read,so);
+	}
+	if((event & NGX_WRITE_EVENT) == NGX_WRITE_EVENT)
+	{
+		select_module_set(module,&module->write_set_cache,so->write,so);
 	}
-	if(module->max_handle <= so->handle)
+	if((event & NGX_ERROR_EVENT) == NGX_ERROR_EVENT)
 	{
-		module->max_handle = so->handle;
+		select_module_set(module,&module->except_set_cache,so->error,so);
 	}
 	return 0;
 }
 
 int select_module_del(select_module_t * module,socket_t * so)
 {
-	int event = NGX_READ_EVENT | NGX_WRITE_EVENT | NGX_ERROR_EVENT;
-	if((event & NGX_READ_EVENT) == NGX_READ_EVENT)
+	if(so->read != NULL)
 	{
-		if(so->read->index != EVENT_INVALID_INDEX)
-		{
-			FD_CLR(so->handle, &module->read_set_cache);
-			int index = so->read->index;
-			so->read->index = EVENT_INVALID_INDEX;
-			if(index == module->events_index-1)
-			{
-				module->events[index] = module->events[module->events_index-1];
-				module->events[index]->index = index;
-			}
-			module->events_index--;
-		}
+		select_module_clr(module,&module->read_set_cache,so->read,so);
 	}
-	if((event & NGX_WRITE_EVENT) == NGX_WRITE_EVENT)
+	if(so->write != NULL)
+	{
+		select_module_clr(module,&module->write_set_cache,so->write,so);
+	}
+	if(so->error != NULL)
 	{
-		if(so->write->index != EVENT_INVALID_INDEX)
+		select_module_clr(module,&module->except_set_cache,so->error,so);
+	}
+	return 0;
+}
+
+int select_module_mod(select_module_t * module,socket_t * so,int event, int flags)
+{
+	if(so->read != NULL)
+	{
+		if((event & NGX_READ_EVENT) == NGX_READ_EVENT)
 		{
-			FD_CLR(so->handle, &module->write_set_cache);
-			int index = so->write->index;
-			so->write->index = EVENT_INVALID_INDEX;
-			if(index == module->events_index-1)
-			{
-				module->events[index] = module->events[module->events_index-1];
-				module->events[index]->index = index;
-			}
-			module->events_index--;
+			if(so->read->index == EVENT_INVALID_INDEX)
+				select_module_set(module,&module->read_set_cache,so->read,so);
+		}else{
+			select_module_clr(module,&module->read_set_cache,so->read,so);
 		}
 	}
-	if((event & NGX_ERROR_EVENT) == NGX_ERROR_EVENT)
+	if(so->write != NULL)
 	{
-		if(so->error->index != EVENT_INVALID_INDEX)
+		if((event & NGX_WRITE_EVENT) == NGX_WRITE_EVENT)
 		{
-			FD_CLR(so->handle, &module->except_set_cache);
-			int index = so->error->index;
-			so->error->index = EVENT_INVALID_INDEX;
-			if(index == module->events_index-1)
-			{
-				module->events[index] = module->events[module->events_index-1];
-				module->events[index]->index = index;
-			}
-			module->events_index--;
+			if(so->write->index == EVENT_INVALID_INDEX)
+				select_module_set(module,&module->write_set_cache,so->write,so);
+		}else{
+			select_module_clr(module,&module->write_set_cache,so->write,so);
 		}
 	}
 	return 0;
@@ -151,6 +177,7 @@ int select_module_process(select_module_t * module,int milliseconds)
 	struct timeval timeout_spec;
     timeout_spec.tv_sec = milliseconds / 1000;
     timeout_spec.tv_usec = (milliseconds % 1000) * 1000;
+	module->syscalls++;
 	int n = select(module->max_handle + 1, &module->read_set, &module->write_set, &module->except_set, &timeout_spec);
 	if(n == 0)
 	{
@@ -164,7 +191,13 @@ int select_module_process(select_module_t * module,int milliseconds)
 	}
 	module->events_count = n;
 	event_handle(module->process);
-	return module->events_count ;
+	//处理时events_count会减到0,返回select报告的就绪数
+	return n;
+}
+
+uint64_t select_module_syscalls(select_module_t * module)
+{
+	return module->syscalls;
 }
 
 void select_module_event_handler(event_t *ev)
@@ -180,17 +213,19 @@ void select_module_event_handler(event_t *ev)
 		{
 			continue;
 		}
-		socket_t *so = (socket_t*)event->data;
+		socket_t *so = module->sockets[i];
 		if(so == NULL) continue;
 		ASSERT(so != NULL);
 		if(so->read == event)
 		{
 			if(FD_ISSET(so->handle,&module->read_set)){
+				so->read->ready = 1;
 				event_handle(so->read);
 				module->events_count--;
 			}
 		}else if(so->write == event){
 			if(FD_ISSET(so->handle,&module->write_set)){
+				so->write->ready = 1;
 				event_handle(so->write);
 				module->events_count--;
 			}
@@ -5,6 +5,10 @@
 
 #if (NGX_HAVE_SELECT)
 
+//可以运行时切换模块,事件值需要和其他模块一致
+#include "EpollModule.h"
+#include "KqueueModule.h"
+
 #ifndef NGX_READ_EVENT
 #define NGX_READ_EVENT 0
 #endif
@@ -56,14 +60,20 @@ typedef struct select_module_s
 	int concurrent;
 	int events_index;
 	int events_count;
+	int events_size;
 	event_t **events;
+	socket_t **sockets;
+	//发起的系统调用数(注册只改fd_set,只有等待),bench用来对比各模块
+	uint64_t syscalls;
 }select_module_t;
 
 select_module_t * select_module_create(int concurrent);
 int select_module_done(select_module_t * module);
 int select_module_add(select_module_t * module,socket_t * obj,int event, int flags);
 int select_module_del(select_module_t * module,socket_t * obj);
+int select_module_mod(select_module_t * module,socket_t * obj,int event, int flags);
 int select_module_process(select_module_t * module,int milliseconds);
+uint64_t select_module_syscalls(select_module_t * module);
 
 #endif
 
@@ -0,0 +1,438 @@
+#include "UringModule.h"
+
+#if (NGX_HAVE_IO_URING)
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define URING_MIN_ENTRIES 64
+#define URING_MAX_ENTRIES 4096
+#define URING_MIN_SLOTS 1024
+
+//POLL_REMOVE 自身的完成事件,直接丢弃
+#define URING_REMOVE_DATA ((uint64_t)-1)
+
+#define uring_user_data(fd,gen) (((uint64_t)(gen) << 32) | (uint32_t)(fd))
+#define uring_user_fd(data) ((int)((data) & 0xFFFFFFFF))
+#define uring_user_gen(data) ((uint32_t)((data) >> 32))
+
+void uring_module_event_handler(event_t *ev);
+
+static inline int uring_setup(unsigned entries,struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup,entries,p);
+}
+
+static inline int uring_enter(int fd,unsigned to_submit,unsigned min_complete,unsigned flags,void *arg,size_t size)
+{
+	return (int)syscall(__NR_io_uring_enter,fd,to_submit,min_complete,flags,arg,size);
+}
+
+static void uring_module_unmap(uring_module_t * module)
+{
+	if(module->sqes != NULL && module->sqes != MAP_FAILED)
+	{
+		munmap(module->sqes,module->sqes_size);
+	}
+	if(module->cq_ptr != NULL && module->cq_ptr != MAP_FAILED && module->cq_ptr != module->sq_ptr)
+	{
+		munmap(module->cq_ptr,module->cq_size);
+	}
+	if(module->sq_ptr != NULL && module->sq_ptr != MAP_FAILED)
+	{
+		munmap(module->sq_ptr,module->sq_size);
+	}
+	module->sqes = NULL;
+	module->cq_ptr = NULL;
+	module->sq_ptr = NULL;
+}
+
+uring_module_t * uring_module_create(int concurrent)
+{
+	struct io_uring_params params;
+	MEMZERO(&params,sizeof(params));
+
+	unsigned entries = (unsigned)max(URING_MIN_ENTRIES,min(concurrent,URING_MAX_ENTRIES));
+	int handle = uring_setup(entries,&params);
+	if(handle < 0)
+	{
+		LOGD("io_uring_setup errno:%d\n",errno);
+		return NULL;
+	}
+	//超时等待依赖 IORING_ENTER_EXT_ARG (5.11+)
+	if(!(params.features & IORING_FEAT_EXT_ARG))
+	{
+		LOGD("io_uring without IORING_FEAT_EXT_ARG.\n");
+		close(handle);
+		return NULL;
+	}
+
+	uring_module_t *module = (uring_module_t*)MALLOC_TAG(MEM_TAG_ACTION,sizeof(uring_module_t));
+	MEMZERO(module,sizeof(uring_module_t));
+	module->handle = handle;
+
+	module->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	module->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		module->sq_size = max(module->sq_size,module->cq_size);
+		module->cq_size = module->sq_size;
+	}
+	module->sq_ptr = mmap(NULL,module->sq_size,PROT_READ | PROT_WRITE,
+						MAP_SHARED | MAP_POPULATE,handle,IORING_OFF_SQ_RING);
+	if(module->sq_ptr == MAP_FAILED)
+	{
+		goto failed;
+	}
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		module->cq_ptr = module->sq_ptr;
+	}else{
+		module->cq_ptr = mmap(NULL,module->cq_size,PROT_READ | PROT_WRITE,
+						MAP_SHARED | MAP_POPULATE,handle,IORING_OFF_CQ_RING);
+		if(module->cq_ptr == MAP_FAILED)
+		{
+			goto failed;
+		}
+	}
+	module->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	module->sqes = (struct io_uring_sqe *)mmap(NULL,module->sqes_size,PROT_READ | PROT_WRITE,
+						MAP_SHARED | MAP_POPULATE,handle,IORING_OFF_SQES);
+	if(module->sqes == MAP_FAILED)
+	{
+		goto failed;
+	}
+
+	module->sq_head = (unsigned*)((char*)module->sq_ptr + params.sq_off.head);
+	module->sq_tail = (unsigned*)((char*)module->sq_ptr + params.sq_off.tail);
+	module->sq_mask = (unsigned*)((char*)module->sq_ptr + params.sq_off.ring_mask);
+	module->sq_array = (unsigned*)((char*)module->sq_ptr + params.sq_off.array);
+	module->sq_entries = params.sq_entries;
+	module->to_submit = 0;
+
+	module->cq_head = (unsigned*)((char*)module->cq_ptr + params.cq_off.head);
+	module->cq_tail = (unsigned*)((char*)module->cq_ptr + params.cq_off.tail);
+	module->cq_mask = (unsigned*)((char*)module->cq_ptr + params.cq_off.ring_mask);
+	module->cqes = (struct io_uring_cqe *)((char*)module->cq_ptr + params.cq_off.cqes);
+
+	module->process = (event_t*)MALLOC(sizeof(event_t));
+	module->process->data = module;
+	module->process->handler = (event_handler_pt)uring_module_event_handler;
+
+	module->max_events_count = concurrent;
+	module->events_count = 0;
+
+	module->slots_count = 0;
+	module->slots = NULL;
+	return module;
+
+failed:
+	LOGE("io_uring mmap errno:%d\n",errno);
+	uring_module_unmap(module);
+	close(handle);
+	FREE(module);
+	return NULL;
+}
+
+int uring_module_done(uring_module_t * module)
+{
+	if(module->process != NULL)
+	{
+		FREE(module->process);
+		module->process = NULL;
+	}
+	if(module->slots != NULL)
+	{
+		FREE(module->slots);
+		module->slots = NULL;
+	}
+	uring_module_unmap(module);
+	close(module->handle);
+	FREE(module);
+	return 0;
+}
+
+static int uring_module_submit(uring_module_t * module)
+{
+	if(module->to_submit <= 0)
+	{
+		return 0;
+	}
+	module->syscalls++;
+	int ret = uring_enter(module->handle,module->to_submit,0,0,NULL,0);
+	if(ret < 0)
+	{
+		LOGE("io_uring_enter submit errno:%d\n",errno);
+		return -1;
+	}
+	module->to_submit -= ret;
+	return ret;
+}
+
+static struct io_uring_sqe * uring_module_sqe(uring_module_t * module)
+{
+	unsigned tail = *module->sq_tail;
+	unsigned head = *(volatile unsigned*)module->sq_head;
+	if(tail - head >= module->sq_entries)
+	{
+		//提交队列已满,先把已有的请求交给内核
+		uring_module_submit(module);
+		head = *(volatile unsigned*)module->sq_head;
+		if(tail - head >= module->sq_entries)
+		{
+			return NULL;
+		}
+	}
+	unsigned index = tail & *module->sq_mask;
+	struct io_uring_sqe * sqe = &module->sqes[index];
+	MEMZERO(sqe,sizeof(struct io_uring_sqe));
+	module->sq_array[index] = index;
+	return sqe;
+}
+
+static inline void uring_module_commit(uring_module_t * module)
+{
+	ngx_memory_barrier();
+	*module->sq_tail = *module->sq_tail + 1;
+	module->to_submit++;
+}
+
+static int uring_module_poll(uring_module_t * module,int fd,uring_slot_t * slot)
+{
+	struct io_uring_sqe * sqe = uring_module_sqe(module);
+	if(sqe == NULL)
+	{
+		errno = EBUSY;
+		return -1;
+	}
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = slot->events;
+	sqe->user_data = uring_user_data(fd,slot->gen);
+	uring_module_commit(module);
+	return 0;
+}
+
+static uring_slot_t * uring_module_slot(uring_module_t * module,int fd)
+{
+	if(fd >= module->slots_count)
+	{
+		int count = max(URING_MIN_SLOTS,module->slots_count);
+		while(count <= fd)
+		{
+			count *= 2;
+		}
+		uring_slot_t * slots = (uring_slot_t*)REALLOC_TAG(MEM_TAG_ACTION,module->slots,sizeof(uring_slot_t)*count);
+		if(slots == NULL)
+		{
+			return NULL;
+		}
+		MEMZERO(slots + module->slots_count,sizeof(uring_slot_t)*(count - module->slots_count));
+		module->slots = slots;
+		module->slots_count = count;
+	}
+	return &module->slots[fd];
+}
+
+int uring_module_add(uring_module_t * module,socket_t * so,int event, int flags)
+{
+	uring_slot_t * slot = uring_module_slot(module,so->handle);
+	if(slot == NULL)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+	if(slot->so != NULL)
+	{
+		errno = EEXIST;
+		return -1;
+	}
+	slot->so = so;
+	slot->gen++;
+	//单次poll,回调后重新挂上,保持和epoll水平触发一致的语义;ET标记对单次poll无意义
+	slot->events = (uint32_t)(event | (flags & ~(NGX_FLAGS_ET | NGX_FLAGS_ONESHAOT)));
+	slot->flags = (uint32_t)flags;
+	int ret = uring_module_poll(module,so->handle,slot);
+	if(ret != 0)
+	{
+		slot->so = NULL;
+	}
+	return ret;
+}
+
+static void uring_module_cancel(uring_module_t * module,int fd,uint32_t gen)
+{
+	struct io_uring_sqe * sqe = uring_module_sqe(module);
+	if(sqe != NULL)
+	{
+		sqe->opcode = IORING_OP_POLL_REMOVE;
+		sqe->fd = -1;
+		sqe->addr = uring_user_data(fd,gen);
+		sqe->user_data = URING_REMOVE_DATA;
+		uring_module_commit(module);
+	}
+	//即使取消请求没提交成功,旧的完成事件也会因为 so/gen 不匹配被丢弃
+}
+
+int uring_module_del(uring_module_t * module,socket_t * so)
+{
+	int fd = so->handle;
+	if(fd < 0 || fd >= module->slots_count || module->slots[fd].so != so)
+	{
+		errno = ENOENT;
+		return -1;
+	}
+	uring_slot_t * slot = &module->slots[fd];
+	slot->so = NULL;
+	uring_module_cancel(module,fd,slot->gen);
+	return 0;
+}
+
+int uring_module_mod(uring_module_t * module,socket_t * so,int event, int flags)
+{
+	int fd = so->handle;
+	if(fd < 0 || fd >= module->slots_count || module->slots[fd].so != so)
+	{
+		errno = ENOENT;
+		return -1;
+	}
+	uring_slot_t * slot = &module->slots[fd];
+	//取消旧的poll,换一个gen重新挂上
+	uring_module_cancel(module,fd,slot->gen);
+	slot->gen++;
+	slot->events = (uint32_t)(event | (flags & ~(NGX_FLAGS_ET | NGX_FLAGS_ONESHAOT)));
+	slot->flags = (uint32_t)flags;
+	return uring_module_poll(module,fd,slot);
+}
+
+int uring_module_process(uring_module_t * module,int milliseconds)
+{
+	struct __kernel_timespec ts;
+	ts.tv_sec = milliseconds / 1000;
+	ts.tv_nsec = (milliseconds % 1000) * 1000000;
+
+	//负数表示一直等待,ts为0时内核不设超时
+	struct io_uring_getevents_arg arg;
+	MEMZERO(&arg,sizeof(arg));
+	arg.ts = milliseconds < 0 ? 0 : (uint64_t)(uintptr_t)&ts;
+
+	//一次系统调用完成提交和等待
+	module->syscalls++;
+	int ret = uring_enter(module->handle,module->to_submit,1,
+						IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,&arg,sizeof(arg));
+	if(ret < 0)
+	{
+		if(errno != ETIME && errno != EINTR && errno != EBUSY)
+		{
+			LOGE("io_uring wait errno:%d\n",errno);
+			return -1;
+		}
+	}else{
+		module->to_submit -= ret;
+	}
+
+	unsigned head = *module->cq_head;
+	unsigned tail = *(volatile unsigned*)module->cq_tail;
+	ngx_memory_barrier();
+	if(head == tail)
+	{
+		return 0;
+	}
+	module->events_count = (int)(tail - head);
+	module->process->handler(module->process);
+	return module->events_count;
+}
+
+uint64_t uring_module_syscalls(uring_module_t * module)
+{
+	return module->syscalls;
+}
+
+void uring_module_event_handler(event_t *ev)
+{
+	uring_module_t * module = (uring_module_t *)ev->data;
+	ASSERT(module != NULL);
+	unsigned head = *module->cq_head;
+	for(int i = 0 ; i < module->events_count;i++)
+	{
+		struct io_uring_cqe *cqe = &module->cqes[head & *module->cq_mask];
+		uint64_t data = cqe->user_data;
+		int res = cqe->res;
+		head++;
+		ngx_memory_barrier();
+		*module->cq_head = head;
+
+		if(data == URING_REMOVE_DATA || res == -ECANCELED)
+		{
+			continue;
+		}
+		int fd = uring_user_fd(data);
+		if(fd >= module->slots_count)
+		{
+			continue;
+		}
+		uring_slot_t * slot = &module->slots[fd];
+		socket_t *so = slot->so;
+		uint32_t gen = uring_user_gen(data);
+		if(so == NULL || slot->gen != gen)
+		{
+			//已删除或fd被复用
+			continue;
+		}
+		if(res < 0)
+		{
+			LOGD("io_uring poll res:%d\n",res);
+			so->error->handler(so->error);
+		}
+		else
+#ifdef POLLRDHUP
+		if(res & POLLRDHUP)
+		{
+			LOGD("POLLRDHUP trigger.\n");
+			so->read->ready = 1;
+			so->read->handler(so->read);
+		}
+		else
+#endif
+		if(res & (POLLHUP | POLLERR))
+		{
+			LOGD("POLLHUP|POLLERR trigger.\n");
+			so->error->handler(so->error);
+		}
+		else
+		if(res & POLLPRI)
+		{
+			LOGD("POLLPRI trigger.\n");
+			//带外数据
+			so->error->handler(so->error);
+		}
+		else {
+			if(res & POLLIN)
+			{
+				so->read->flags = 0;
+				so->read->ready = 1;
+				so->read->handler(so->read);
+			}
+			if(res & POLLOUT)
+			{
+				so->write->flags = 0;
+				so->write->ready = 1;
+				so->write->handler(so->write);
+			}
+		}
+
+		//回调中没有删除的话重新挂上poll,回调里可能扩容了slots
+		slot = &module->slots[fd];
+		if(slot->so == so && slot->gen == gen && !(slot->flags & NGX_FLAGS_ONESHAOT))
+		{
+			if(uring_module_poll(module,fd,slot) != 0)
+			{
+				LOGE("io_uring rearm fd:%d errno:%d\n",fd,errno);
+			}
+		}
+	}
+}
+
+#endif
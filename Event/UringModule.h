@@ -0,0 +1,79 @@
+#ifndef URING_module_H
+#define URING_module_H
+
+#include "Socket.h"
+#include "Event.h"
+
+#if defined(__linux__) && !defined(NGX_NO_IO_URING)
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define NGX_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#if (NGX_HAVE_IO_URING)
+
+//实验性模块,auto不会选择,只能按名字指定(EVENT_MODULE=uring或server的第一个参数)
+//只把io_uring当作就绪通知:每个fd挂一个单次POLL_ADD,回调后重新挂上,和epoll水平触发语义一致
+//accept/recv/send仍然由buffer_read/buffer_write各自发起系统调用,不是基于完成的IO,
+//每个请求的系统调用数不比epoll少,重新挂上的SQE和等待合在同一次io_uring_enter里提交
+#include <linux/io_uring.h>
+//事件和标记定义与epoll保持一致
+#include "EpollModule.h"
+
+//每个fd一个槽位,完成事件通过 fd+gen 找回socket,防止已删除的socket被回调
+typedef struct uring_slot_s
+{
+	socket_t * so;
+	uint32_t gen;
+	uint32_t events;
+	uint32_t flags;
+}uring_slot_t;
+
+typedef struct uring_module_s
+{
+	int handle;
+	event_t * process;
+
+	//提交队列
+	void * sq_ptr;
+	size_t sq_size;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned sq_entries;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	int to_submit;
+
+	//完成队列
+	void * cq_ptr;
+	size_t cq_size;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	int max_events_count;
+	int events_count;
+
+	int slots_count;
+	uring_slot_t * slots;
+
+	//发起的系统调用数(io_uring_enter),bench用来对比各模块
+	uint64_t syscalls;
+}uring_module_t;
+
+uring_module_t * uring_module_create(int concurrent);
+int uring_module_done(uring_module_t * module);
+int uring_module_add(uring_module_t * module,socket_t * so,int event, int flags);
+int uring_module_del(uring_module_t * module,socket_t * so);
+int uring_module_mod(uring_module_t * module,socket_t * so,int event, int flags);
+int uring_module_process(uring_module_t * module,int milliseconds);
+uint64_t uring_module_syscalls(uring_module_t * module);
+
+#endif
+
+#endif
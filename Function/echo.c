@@ -1,11 +1,18 @@
 #include "../Module/module.h"
+#include "../Module/zerocopy.h"
 #include "echo.h"
+#include "frame.h"
+#include "output.h"
 
 #ifndef _WIN32
 #include <sys/types.h>
 #include <sys/socket.h>
 #endif
 
+#if (NGX_HAVE_SPLICE)
+#include <fcntl.h>
+#endif
+
 int buffer_read(connection_t * c,char *byte,size_t len)
 {
 	int ret = recv(c->so.handle,byte,len,0);
@@ -55,136 +62,795 @@ int buffer_write(connection_t * c,char * byte,size_t len)
 	return 0;
 }
 
+int buffer_readv(connection_t * c,socket_iovec_t * iov,int count)
+{
+	int ret = socket_readv(c->so.handle,iov,count);
+	if(ret > 0)
+	{
+		return ret;
+	}
+	else if(ret == 0)
+	{
+		connection_remove(c);
+		return -1;
+	}else
+	{
+		if(_ERRNO == _ERROR(EWOULDBLOCK))
+		{
+			return 0;
+		}
+		LOGE("readv error:%d errno:%d\n",ret,_ERRNO);
+		connection_remove(c);
+		return -1;
+	}
+}
+
+int buffer_writev(connection_t * c,socket_iovec_t * iov,int count)
+{
+	int ret = socket_writev(c->so.handle,iov,count);
+	if(ret >= 0)
+	{
+		return ret;
+	}
+	if(_ERRNO == _ERROR(EWOULDBLOCK))
+	{
+		return 0;
+	}
+	LOGE("writev error:%d errno:%d\n",ret,_ERRNO);
+	connection_remove(c);
+	return -1;
+}
+
+int buffer_sendv(connection_t * c,socket_iovec_t * iov,int count,int flags)
+{
+	int ret = socket_sendv(c->so.handle,iov,count,flags);
+	if(ret >= 0)
+	{
+		return ret;
+	}
+	if(_ERRNO == _ERROR(EWOULDBLOCK))
+	{
+		return 0;
+	}
+	LOGE("sendv error:%d errno:%d\n",ret,_ERRNO);
+	connection_remove(c);
+	return -1;
+}
 
 typedef struct echo_s {
 	connection_t * c;
 	loopqueue_t queue;
+	int cls;		//下次借用缓冲区的大小级别
+	int peak;		//本次借用期间队列中最多的字节数
+	int grow;		//本次借用期间缓冲区被读满过
 }echo_t;
 
+//有数据要读时才从cycle借缓冲区
+static int echo_borrow(echo_t * echo)
+{
+	if(echo->queue.data != NULL)
+	{
+		return 0;
+	}
+	void * data = buffer_pool_alloc(&echo->c->cycle->buffer_pool,echo->cls);
+	if(data == NULL)
+	{
+		return -1;
+	}
+	queue_attach(&echo->queue,data,(int)buffer_class_size(echo->cls));
+	//队列满时暂停读,发出一半后恢复
+	connection_watermark_set(echo->c,(uint32_t)buffer_class_size(echo->cls),(uint32_t)buffer_class_size(echo->cls) / 2);
+	echo->peak = 0;
+	echo->grow = 0;
+	return 0;
+}
+
+//数据发完后归还,按这次的流量调整下次借用的级别:读满过就升一级,否则最多降一级
+static void echo_return(echo_t * echo)
+{
+	if(echo->queue.data == NULL)
+	{
+		return;
+	}
+	buffer_pool_free(&echo->c->cycle->buffer_pool,echo->cls,queue_detach(&echo->queue));
+	if(echo->grow)
+	{
+		if(echo->cls < BUFFER_CLASS_COUNT - 1) echo->cls++;
+	}else{
+		int fit = buffer_class_fit(echo->peak);
+		if(fit < echo->cls) echo->cls--;
+	}
+}
+
+static void echo_cleanup(void *data)
+{
+	echo_return((echo_t*)data);
+}
+
+//echo_t 分配在连接内存池上,连接释放时一起释放
 echo_t *echo_create(connection_t *c)
 {
-	echo_t * echo = (echo_t*)MALLOC(sizeof(echo_t));
+	ngx_pool_t * pool = connection_pool(c);
+	if(pool == NULL)
+	{
+		return NULL;
+	}
+	ngx_pool_cleanup_t * cln = ngx_pool_cleanup_add(pool,0);
+	echo_t * echo = (echo_t*)ngx_pcalloc(pool,sizeof(echo_t));
+	if(cln == NULL || echo == NULL)
+	{
+		return NULL;
+	}
 	echo->c = c;
-	queue_init(&echo->queue,12);
+	echo->cls = 0;
+	queue_detach(&echo->queue);
+	cln->handler = echo_cleanup;
+	cln->data = echo;
 	return echo;
 }
 
-void echo_destroy(echo_t **echo_ptr)
+void echo_read_event_handler(event_t *ev)
 {
-	if(echo_ptr != NULL)
+
+	echo_t * echo = (echo_t*)ev->data;
+	connection_t *c = (connection_t*)echo->c;
+
+	event_del(c->cycle,c->so.read);
+	timer_del(c->cycle,c->so.read);
+
+	if(echo_borrow(echo) != 0)
 	{
-		echo_t * echo = *echo_ptr;
-		if(echo != NULL)
+		LOGE("echo borrow buffer failed:%d\n",c->so.handle);
+		connection_remove(c);
+		return;
+	}
+	//读到EAGAIN为止,边缘触发下不读完不会再有通知
+	//环形队列绕回时两段一起读
+	while(1)
+	{
+		socket_iovec_t iov[2];
+		int count = queue_wiov(&echo->queue,iov);
+		if(count == 0){
+			//队列满了,ready保持1,暂停读,写出数据后由写事件恢复并重新投递读事件
+			echo->grow = 1;
+			break;
+		}
+		int ret = buffer_readv(c,iov,count);
+		if(ret < 0)
+		{
+			return;
+		}
+		if(ret == 0)
 		{
-			queue_delete(&echo->queue);
-			FREE(echo);
-			*echo_ptr = NULL;
+			//没有数据时等待可读事件
+			ev->ready = 0;
+			break;
 		}
+		queue_wpushv(&echo->queue,ret);
+	}
+	int used = queue_used(&echo->queue);
+	if(used > echo->peak) echo->peak = used;
+	connection_watermark(c,used);
+	if(used > 0)
+	{
+		if(!event_is_add(c->cycle,c->so.write))
+			event_add(c->cycle,c->so.write);
+	}else{
+		echo_return(echo);
 	}
 }
 
-void echo_read_event_handler(event_t *ev)
+void echo_write_event_handler(event_t *ev)
 {
+	echo_t * echo = (echo_t*)ev->data;
+	connection_t *c = (connection_t*)echo->c;
+	event_del(c->cycle,c->so.write);
+	timer_del(c->cycle,c->so.write);
+	//写到EAGAIN或者队列空为止
+	while(1)
+	{
+		socket_iovec_t iov[2];
+		int count = queue_riov(&echo->queue,iov);
+		if(count == 0)
+		{
+			//数据发完,缓冲区还给cycle
+			if(!c->so.read->ready) echo_return(echo);
+			connection_cycle_mod(c,NGX_READ_EVENT);
+			break;
+		}
+		int ret = buffer_writev(c,iov,count);
+		if(ret < 0)
+		{
+			return;
+		}
+		if(ret == 0)
+		{
+			//发送缓冲区满,等待可写事件
+			ev->ready = 0;
+			connection_cycle_mod(c,NGX_READ_EVENT | NGX_WRITE_EVENT);
+			break;
+		}
+		queue_rpushv(&echo->queue,ret);
+	}
+	//读端还有数据没读完,腾出空间且不在暂停中时继续读
+	if(!connection_watermark(c,queue_used(&echo->queue))
+		&& c->so.read->ready && (echo->queue.data == NULL || queue_w(&echo->queue) != NULL))
+	{
+		if(!event_is_add(c->cycle,c->so.read))
+			event_add(c->cycle,c->so.read);
+	}
+}
 
+void echo_error_event_handler(event_t * ev)
+{
 	echo_t * echo = (echo_t*)ev->data;
 	connection_t *c = (connection_t*)echo->c;
+	connection_del(c);
+}
+
+void echo_init(connection_t * c)
+{
+	ASSERT(c != NULL);
+	echo_t * echo = echo_create(c);
+	if(echo == NULL)
+	{
+		LOGE("echo_create failed:%d\n",c->so.handle);
+		event_init(c->so.read,connection_error_handle,c);
+		event_init(c->so.write,connection_error_handle,c);
+		event_init(c->so.error,connection_error_handle,c);
+		return;
+	}
+	event_init(c->so.read,echo_read_event_handler,echo);
+	event_init(c->so.write,echo_write_event_handler,echo);
+	event_init(c->so.error,echo_error_event_handler,echo);
+	timer_add(c->cycle,c->so.read,1000);
+}
+
+#if (NGX_HAVE_SPLICE)
+
+//splice: 数据经连接自己的管道从socket转回socket,不进入用户态
+typedef struct echo_splice_s {
+	connection_t * c;
+	int pipe[2];		//第一次有数据时创建
+	size_t pending;		//管道中还没发出去的字节数
+}echo_splice_t;
+
+#define ECHO_SPLICE_SIZE (64*1024)
+
+static void echo_splice_cleanup(void *data)
+{
+	echo_splice_t * es = (echo_splice_t*)data;
+	if(es->pipe[0] != -1)
+	{
+		close(es->pipe[0]);
+		close(es->pipe[1]);
+		es->pipe[0] = -1;
+		es->pipe[1] = -1;
+	}
+}
+
+echo_splice_t *echo_splice_create(connection_t *c)
+{
+	ngx_pool_t * pool = connection_pool(c);
+	if(pool == NULL)
+	{
+		return NULL;
+	}
+	ngx_pool_cleanup_t * cln = ngx_pool_cleanup_add(pool,0);
+	echo_splice_t * es = (echo_splice_t*)ngx_pcalloc(pool,sizeof(echo_splice_t));
+	if(cln == NULL || es == NULL)
+	{
+		return NULL;
+	}
+	es->c = c;
+	es->pipe[0] = -1;
+	es->pipe[1] = -1;
+	//管道装满时暂停读
+	connection_watermark_set(c,ECHO_SPLICE_SIZE,ECHO_SPLICE_SIZE / 2);
+	cln->handler = echo_splice_cleanup;
+	cln->data = es;
+	return es;
+}
+
+void echo_splice_read_event_handler(event_t *ev)
+{
+	echo_splice_t * es = (echo_splice_t*)ev->data;
+	connection_t *c = (connection_t*)es->c;
 
 	event_del(c->cycle,c->so.read);
 	timer_del(c->cycle,c->so.read);
 
-	// while(1)
+	if(es->pipe[0] == -1 && pipe2(es->pipe,O_NONBLOCK | O_CLOEXEC) != 0)
 	{
-		void * buffer = queue_w(&echo->queue);
-		int size = queue_wsize(&echo->queue);
-		if(buffer == NULL || size <= 0){
-
-			return;
+		LOGE("pipe2 errno:%d\n",_ERRNO);
+		es->pipe[0] = -1;
+		connection_remove(c);
+		return;
+	}
+	while(1)
+	{
+		ssize_t ret = splice(c->so.handle,NULL,es->pipe[1],NULL,ECHO_SPLICE_SIZE,SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if(ret > 0)
+		{
+			es->pending += ret;
+			continue;
 		}
-		int ret = buffer_read(c,buffer,size);
-		if(ret < 0)
+		if(ret == 0)
 		{
-			timer_add(c->cycle,c->so.read,1000);
+			connection_remove(c);
 			return;
 		}
-		if(ret == 0)
+		if(_ERRNO != _ERROR(EWOULDBLOCK))
 		{
-			timer_add(c->cycle,c->so.read,1000);
+			LOGE("splice recv error:%d errno:%d\n",(int)ret,_ERRNO);
+			connection_remove(c);
 			return;
 		}
-		queue_wpush(&echo->queue,ret);
-		if(ret == size)
+		//管道为空时EAGAIN只能来自socket;否则可能是管道满了,ready保持1,发完后由写事件重新投递读事件
+		if(es->pending == 0)
 		{
-			// 获取接受缓冲区数据大小
-			if(socket_recvbuf_size(c->so.handle) > 0)
-			{
-				// 获取
-				size = queue_wsize(&echo->queue);
-				if(size > 0)
-				{
-					if(!event_is_add(c->cycle,c->so.read))
-						event_add(c->cycle,c->so.read);
-				}else
-				{
-					event_add(c->cycle,c->so.read);
-				}
-			}
+			ev->ready = 0;
 		}
+		break;
+	}
+	connection_watermark(c,(uint32_t)es->pending);
+	if(es->pending > 0)
+	{
 		if(!event_is_add(c->cycle,c->so.write))
 			event_add(c->cycle,c->so.write);
 	}
-	timer_add(c->cycle,c->so.read,1000);
 }
 
-void echo_write_event_handler(event_t *ev)
+void echo_splice_write_event_handler(event_t *ev)
 {
-	echo_t * echo = (echo_t*)ev->data;
-	connection_t *c = (connection_t*)echo->c;
+	echo_splice_t * es = (echo_splice_t*)ev->data;
+	connection_t *c = (connection_t*)es->c;
 	event_del(c->cycle,c->so.write);
 	timer_del(c->cycle,c->so.write);
-	// while(1)
+	while(1)
 	{
-		void * buffer = queue_r(&echo->queue);
-		int size = queue_rsize(&echo->queue);
-		if(buffer == NULL || size <= 0)
+		if(es->pending == 0)
 		{
+			connection_cycle_mod(c,NGX_READ_EVENT);
+			break;
+		}
+		ssize_t ret = splice(es->pipe[0],NULL,c->so.handle,NULL,es->pending,SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if(ret > 0)
+		{
+			es->pending -= ret;
+			continue;
+		}
+		if(ret < 0 && _ERRNO == _ERROR(EWOULDBLOCK))
+		{
+			//管道里有数据,EAGAIN来自socket发送缓冲区满
+			ev->ready = 0;
+			connection_cycle_mod(c,NGX_READ_EVENT | NGX_WRITE_EVENT);
+			break;
+		}
+		LOGE("splice send error:%d errno:%d\n",(int)ret,_ERRNO);
+		connection_remove(c);
+		return;
+	}
+	if(!connection_watermark(c,(uint32_t)es->pending) && c->so.read->ready)
+	{
+		if(!event_is_add(c->cycle,c->so.read))
+			event_add(c->cycle,c->so.read);
+	}
+}
+
+void echo_splice_init(connection_t * c)
+{
+	ASSERT(c != NULL);
+	echo_splice_t * es = echo_splice_create(c);
+	if(es == NULL)
+	{
+		LOGE("echo_splice_create failed:%d\n",c->so.handle);
+		event_init(c->so.read,connection_error_handle,c);
+		event_init(c->so.write,connection_error_handle,c);
+		event_init(c->so.error,connection_error_handle,c);
+		return;
+	}
+	event_init(c->so.read,echo_splice_read_event_handler,es);
+	event_init(c->so.write,echo_splice_write_event_handler,es);
+	event_init(c->so.error,connection_error_handle,c);
+	timer_add(c->cycle,c->so.read,1000);
+}
+
+#else
+
+void echo_splice_init(connection_t * c)
+{
+	echo_init(c);
+}
+
+#endif
+
+//zerocopy: 大块数据用MSG_ZEROCOPY发回
+//发出去的数据在完成通知到达前不能覆盖,缓冲区只顺序写一遍,发完后交给零拷贝状态,完成后再还给cycle
+typedef struct echo_zerocopy_s {
+	connection_t * c;
+	uint8_t * data;
+	uint32_t size;
+	uint32_t r;
+	uint32_t w;
+}echo_zerocopy_t;
+
+#define ECHO_ZEROCOPY_CLASS (BUFFER_CLASS_COUNT - 1)
+
+static void echo_zerocopy_free(void * data,void * buf,size_t size)
+{
+	echo_zerocopy_t * ez = (echo_zerocopy_t*)data;
+	buffer_pool_free(&ez->c->cycle->buffer_pool,buffer_class_fit(size),buf);
+}
+
+//当前缓冲区不再使用,等之前的零拷贝发送完成后归还
+static void echo_zerocopy_retire(echo_zerocopy_t * ez)
+{
+	if(ez->data == NULL)
+	{
+		return;
+	}
+	if(connection_zerocopy_release(ez->c,echo_zerocopy_free,ez,ez->data,ez->size) != 0)
+	{
+		//登记失败时宁可泄漏也不能归还内核还在用的内存
+		LOGE("zerocopy release failed:%d\n",ez->c->so.handle);
+	}
+	ez->data = NULL;
+}
+
+//连接释放时零拷贝状态已经清理过,直接归还
+static void echo_zerocopy_cleanup(void *data)
+{
+	echo_zerocopy_t * ez = (echo_zerocopy_t*)data;
+	if(ez->data != NULL)
+	{
+		echo_zerocopy_free(ez,ez->data,ez->size);
+		ez->data = NULL;
+	}
+}
+
+echo_zerocopy_t *echo_zerocopy_create(connection_t *c)
+{
+	ngx_pool_t * pool = connection_pool(c);
+	if(pool == NULL)
+	{
+		return NULL;
+	}
+	ngx_pool_cleanup_t * cln = ngx_pool_cleanup_add(pool,0);
+	echo_zerocopy_t * ez = (echo_zerocopy_t*)ngx_pcalloc(pool,sizeof(echo_zerocopy_t));
+	if(cln == NULL || ez == NULL)
+	{
+		return NULL;
+	}
+	ez->c = c;
+	//缓冲区只顺序写一遍,写满后暂停读,整块发完交还后恢复
+	connection_watermark_set(c,(uint32_t)buffer_class_size(ECHO_ZEROCOPY_CLASS),0);
+	cln->handler = echo_zerocopy_cleanup;
+	cln->data = ez;
+	return ez;
+}
+
+void echo_zerocopy_read_event_handler(event_t *ev)
+{
+	echo_zerocopy_t * ez = (echo_zerocopy_t*)ev->data;
+	connection_t *c = (connection_t*)ez->c;
+
+	event_del(c->cycle,c->so.read);
+	timer_del(c->cycle,c->so.read);
+
+	if(ez->data != NULL && ez->r == ez->size)
+	{
+		echo_zerocopy_retire(ez);
+	}
+	if(ez->data == NULL)
+	{
+		ez->data = (uint8_t*)buffer_pool_alloc(&c->cycle->buffer_pool,ECHO_ZEROCOPY_CLASS);
+		if(ez->data == NULL)
+		{
+			LOGE("echo borrow buffer failed:%d\n",c->so.handle);
+			connection_remove(c);
 			return;
 		}
-		int ret = buffer_write(c,buffer,size);
+		ez->size = (uint32_t)buffer_class_size(ECHO_ZEROCOPY_CLASS);
+		ez->r = 0;
+		ez->w = 0;
+	}
+	//缓冲区写满时ready保持1,发完后由写事件重新投递读事件
+	while(ez->w < ez->size)
+	{
+		int ret = buffer_read(c,(char*)ez->data + ez->w,ez->size - ez->w);
 		if(ret < 0)
 		{
 			return;
 		}
 		if(ret == 0)
 		{
-			timer_add(c->cycle,c->so.write,100);
+			ev->ready = 0;
+			break;
+		}
+		ez->w += ret;
+	}
+	connection_watermark(c,ez->w);
+	if(ez->w > ez->r)
+	{
+		if(!event_is_add(c->cycle,c->so.write))
+			event_add(c->cycle,c->so.write);
+	}
+}
+
+void echo_zerocopy_write_event_handler(event_t *ev)
+{
+	echo_zerocopy_t * ez = (echo_zerocopy_t*)ev->data;
+	connection_t *c = (connection_t*)ez->c;
+	event_del(c->cycle,c->so.write);
+	timer_del(c->cycle,c->so.write);
+	while(ez->data != NULL && ez->r < ez->w)
+	{
+		int ret = connection_send_zerocopy(c,ez->data + ez->r,ez->w - ez->r);
+		if(ret < 0)
+		{
+			if(_ERRNO == _ERROR(EWOULDBLOCK))
+			{
+				//select把错误队列里的完成通知当成可写,不取走会一直唤醒
+				connection_zerocopy_complete(c);
+				ev->ready = 0;
+				connection_cycle_mod(c,NGX_READ_EVENT | NGX_WRITE_EVENT);
+				return;
+			}
+			LOGE("send error:%d errno:%d\n",ret,_ERRNO);
+			connection_remove(c);
 			return;
 		}
-		queue_rpush(&echo->queue,ret);
-		size = queue_rsize(&echo->queue);
-		if(size > 0)
+		ez->r += ret;
+	}
+	connection_cycle_mod(c,NGX_READ_EVENT);
+	//写满并发完,或者暂时没有数据可读时,交还缓冲区
+	if(ez->data != NULL && (ez->r == ez->size || !c->so.read->ready))
+	{
+		echo_zerocopy_retire(ez);
+	}
+	if(!connection_watermark(c,ez->data != NULL ? ez->w : 0) && c->so.read->ready)
+	{
+		if(!event_is_add(c->cycle,c->so.read))
+			event_add(c->cycle,c->so.read);
+	}
+}
+
+//错误事件可能只是零拷贝的完成通知,或者完成通知已经被写事件取走
+//connection_remove请求关闭,或者错误队列、SO_ERROR报告了错误时才关闭连接
+void echo_zerocopy_error_event_handler(event_t * ev)
+{
+	echo_zerocopy_t * ez = (echo_zerocopy_t*)ev->data;
+	connection_t *c = (connection_t*)ez->c;
+	if(c->closing)
+	{
+		connection_del(c);
+		return;
+	}
+	//connection_zerocopy_complete在SO_ERROR不为0时也返回-1
+	int ret = connection_zerocopy_complete(c);
+	if(ret > 0)
+	{
+		return;
+	}
+	if(ret < 0)
+	{
+		LOGD("zerocopy socket error:%d\n",c->so.handle);
+		connection_del(c);
+		return;
+	}
+	//对端挂断时没有错误码,交给读事件读到结束后关闭,没有挂断时读到EAGAIN继续使用
+	c->so.read->ready = 1;
+	if(!c->read_paused && !event_is_add(c->cycle,c->so.read))
+	{
+		event_add(c->cycle,c->so.read);
+	}
+}
+
+void echo_zerocopy_init(connection_t * c)
+{
+	ASSERT(c != NULL);
+	echo_zerocopy_t * ez = echo_zerocopy_create(c);
+	if(ez == NULL)
+	{
+		LOGE("echo_zerocopy_create failed:%d\n",c->so.handle);
+		event_init(c->so.read,connection_error_handle,c);
+		event_init(c->so.write,connection_error_handle,c);
+		event_init(c->so.error,connection_error_handle,c);
+		return;
+	}
+	//不支持时照常用普通send
+	connection_zerocopy_enable(c);
+	event_init(c->so.read,echo_zerocopy_read_event_handler,ez);
+	event_init(c->so.write,echo_zerocopy_write_event_handler,ez);
+	event_init(c->so.error,echo_zerocopy_error_event_handler,ez);
+	timer_add(c->cycle,c->so.read,1000);
+}
+
+void echo_datagram_handler(connection_datagram_t * d,datagram_msg_t * msgs,int count)
+{
+	for(int i = 0;i < count;i++)
+	{
+		datagram_msg_t * m = &msgs[i];
+		datagram_send(d,(struct sockaddr*)&m->addr,m->addrlen,m->data,m->len,m->segment);
+	}
+}
+
+//frame: 按varint长度前缀分帧,每帧原样带前缀发回,发送经过按tick合并的输出队列
+typedef struct echo_frame_s {
+	connection_t * c;
+	loopqueue_t queue;			//接收队列,有数据时借用,要能放下最长的帧
+	frame_decoder_t decoder;
+}echo_frame_t;
+
+#define ECHO_FRAME_CLASS (BUFFER_CLASS_COUNT - 1)
+#define ECHO_FRAME_MAX (32*1024)
+
+static void echo_frame_cleanup(void *data)
+{
+	echo_frame_t * ef = (echo_frame_t*)data;
+	if(ef->queue.data != NULL)
+	{
+		buffer_pool_free(&ef->c->cycle->buffer_pool,ECHO_FRAME_CLASS,queue_detach(&ef->queue));
+	}
+	frame_decoder_done(&ef->decoder);
+}
+
+echo_frame_t *echo_frame_create(connection_t *c)
+{
+	ngx_pool_t * pool = connection_pool(c);
+	if(pool == NULL)
+	{
+		return NULL;
+	}
+	ngx_pool_cleanup_t * cln = ngx_pool_cleanup_add(pool,0);
+	echo_frame_t * ef = (echo_frame_t*)ngx_pcalloc(pool,sizeof(echo_frame_t));
+	if(cln == NULL || ef == NULL)
+	{
+		return NULL;
+	}
+	ef->c = c;
+	queue_detach(&ef->queue);
+	frame_decoder_init(&ef->decoder,FRAME_PREFIX_VARINT,ECHO_FRAME_MAX);
+	cln->handler = echo_frame_cleanup;
+	cln->data = ef;
+	return ef;
+}
+
+//输出队列放不下整帧时停下,等写事件发出去后继续
+static int echo_frame_handler(void * data,const uint8_t * frame,uint32_t len)
+{
+	echo_frame_t * ef = (echo_frame_t*)data;
+	uint8_t prefix[FRAME_PREFIX_MAX];
+	int n = frame_prefix_encode(ef->decoder.prefix,len,prefix);
+	int space = connection_output_reserve(ef->c,n + len);
+	if(space < 0 || (uint32_t)space < n + len)
+	{
+		return 1;
+	}
+	connection_write(ef->c,prefix,n);
+	connection_write(ef->c,frame,len);
+	return 0;
+}
+
+//返回-1时连接已经关闭
+static int echo_frame_process(echo_frame_t * ef)
+{
+	if(ef->queue.data == NULL)
+	{
+		return 0;
+	}
+	if(frame_decode(&ef->decoder,&ef->queue,echo_frame_handler,ef) < 0)
+	{
+		connection_remove(ef->c);
+		return -1;
+	}
+	if(queue_used(&ef->queue) == 0)
+	{
+		buffer_pool_free(&ef->c->cycle->buffer_pool,ECHO_FRAME_CLASS,queue_detach(&ef->queue));
+	}else if(queue_w(&ef->queue) == NULL)
+	{
+		//接收队列满而且帧卡在输出上,暂停读;输出发出去后由水位或写事件恢复
+		//否则水平触发的事件模块每一轮都会唤醒读事件,什么也读不到
+		connection_read_pause(ef->c);
+	}
+	return 0;
+}
+
+void echo_frame_read_event_handler(event_t *ev)
+{
+	echo_frame_t * ef = (echo_frame_t*)ev->data;
+	connection_t *c = (connection_t*)ef->c;
+
+	event_del(c->cycle,c->so.read);
+	timer_del(c->cycle,c->so.read);
+
+	if(ef->queue.data == NULL)
+	{
+		void * data = buffer_pool_alloc(&c->cycle->buffer_pool,ECHO_FRAME_CLASS);
+		if(data == NULL)
+		{
+			LOGE("echo borrow buffer failed:%d\n",c->so.handle);
+			connection_remove(c);
+			return;
+		}
+		queue_attach(&ef->queue,data,(int)buffer_class_size(ECHO_FRAME_CLASS));
+	}
+	while(1)
+	{
+		socket_iovec_t iov[2];
+		int count = queue_wiov(&ef->queue,iov);
+		if(count == 0)
+		{
+			//队列满了,解出的帧腾出空间后由写事件重新投递读事件
+			break;
+		}
+		int ret = buffer_readv(c,iov,count);
+		if(ret < 0)
+		{
+			return;
+		}
+		if(ret == 0)
 		{
-			if(!event_is_add(c->cycle,c->so.write))
-				event_add(c->cycle,c->so.write);
+			ev->ready = 0;
+			break;
 		}
+		queue_wpushv(&ef->queue,ret);
+	}
+	int full = queue_w(&ef->queue) == NULL;
+	if(echo_frame_process(ef) != 0)
+	{
+		return;
+	}
+	//读满后解出了帧,继续读剩下的
+	if(full && ev->ready && !c->read_paused && (ef->queue.data == NULL || queue_w(&ef->queue) != NULL))
+	{
+		if(!event_is_add(c->cycle,c->so.read))
+			event_add(c->cycle,c->so.read);
 	}
 }
 
-void echo_error_event_handler(event_t * ev)
+void echo_frame_write_event_handler(event_t *ev)
 {
-	echo_t * echo = (echo_t*)ev->data;
-	connection_t *c = (connection_t*)echo->c;
-	if(connection_del(c) == 0)
+	echo_frame_t * ef = (echo_frame_t*)ev->data;
+	connection_t *c = (connection_t*)ef->c;
+	event_del(c->cycle,c->so.write);
+	timer_del(c->cycle,c->so.write);
+	if(connection_flush(c) < 0)
 	{
-		echo_destroy(&echo);
+		return;
+	}
+	//输出腾出空间后处理积压的帧,接收队列有空位时恢复读
+	if(echo_frame_process(ef) != 0)
+	{
+		return;
+	}
+	if(c->read_paused && (ef->queue.data == NULL || queue_w(&ef->queue) != NULL)
+		&& connection_output_pending(c) <= (int)c->low_water)
+	{
+		connection_read_resume(c);
+	}
+	if(c->so.read->ready && !c->read_paused)
+	{
+		if(!event_is_add(c->cycle,c->so.read))
+			event_add(c->cycle,c->so.read);
 	}
 }
 
-void echo_init(connection_t * c)
+void echo_frame_init(connection_t * c)
 {
 	ASSERT(c != NULL);
-	echo_t * echo = echo_create(c);
-	c->so.read = event_create(echo_read_event_handler,echo);
-	c->so.write = event_create(echo_write_event_handler,echo);
-	c->so.error = event_create(echo_error_event_handler,echo);
+	echo_frame_t * ef = echo_frame_create(c);
+	if(ef == NULL)
+	{
+		LOGE("echo_frame_create failed:%d\n",c->so.handle);
+		event_init(c->so.read,connection_error_handle,c);
+		event_init(c->so.write,connection_error_handle,c);
+		event_init(c->so.error,connection_error_handle,c);
+		return;
+	}
+	event_init(c->so.read,echo_frame_read_event_handler,ef);
+	event_init(c->so.write,echo_frame_write_event_handler,ef);
+	event_init(c->so.error,connection_error_handle,c);
 	timer_add(c->cycle,c->so.read,1000);
 }
@@ -3,11 +3,34 @@
 
 #include "../Event/Event.h"
 #include "loopqueue.h"
+#include "../Module/datagram.h"
 
 int buffer_read(connection_t * c,char *byte,size_t len);
 
 int buffer_write(connection_t * c,char * byte,size_t size);
 
+//一次读写多段内存,返回值和buffer_read/buffer_write一样
+int buffer_readv(connection_t * c,socket_iovec_t * iov,int count);
+
+int buffer_writev(connection_t * c,socket_iovec_t * iov,int count);
+//flags传给send,例如SOCKET_MSG_MORE
+int buffer_sendv(connection_t * c,socket_iovec_t * iov,int count,int flags);
+
 void echo_init(connection_t * c);
 
+//Linux上用splice经管道回写,数据不复制到用户态;其他平台等同echo_init
+#if defined(__linux__)
+#define NGX_HAVE_SPLICE 1
+#endif
+void echo_splice_init(connection_t * c);
+
+//大块数据用MSG_ZEROCOPY发回,不支持时退回普通send
+void echo_zerocopy_init(connection_t * c);
+
+//按varint长度前缀分帧,每帧原样发回
+void echo_frame_init(connection_t * c);
+
+//UDP端点上把收到的数据报原样发回,GRO合并的一批用UDP_SEGMENT整块发回
+void echo_datagram_handler(connection_datagram_t * d,datagram_msg_t * msgs,int count);
+
 #endif
@@ -0,0 +1,160 @@
+#include "frame.h"
+
+int frame_decoder_init(frame_decoder_t * f,int prefix,uint32_t max_frame)
+{
+	MEMZERO(f,sizeof(frame_decoder_t));
+	if(prefix != FRAME_PREFIX_VARINT && prefix != 1 && prefix != 2 && prefix != 4)
+	{
+		LOGE("invalid frame prefix:%d\n",prefix);
+		return -1;
+	}
+	//固定宽度的前缀表示不了的长度不允许
+	if(prefix == 1 && max_frame > 0xFF) max_frame = 0xFF;
+	if(prefix == 2 && max_frame > 0xFFFF) max_frame = 0xFFFF;
+	f->prefix = prefix;
+	f->max_frame = max_frame;
+	return 0;
+}
+
+void frame_decoder_done(frame_decoder_t * f)
+{
+	if(f->scratch != NULL)
+	{
+		FREE(f->scratch);
+		f->scratch = NULL;
+	}
+}
+
+int frame_prefix_encode(int prefix,uint32_t len,uint8_t out[FRAME_PREFIX_MAX])
+{
+	if(prefix == FRAME_PREFIX_VARINT)
+	{
+		int n = 0;
+		while(len >= 0x80)
+		{
+			out[n++] = (uint8_t)(len | 0x80);
+			len >>= 7;
+		}
+		out[n++] = (uint8_t)len;
+		return n;
+	}
+	if((prefix == 1 && len > 0xFF) || (prefix == 2 && len > 0xFFFF))
+	{
+		return -1;
+	}
+	for(int i = prefix - 1;i >= 0;i--)
+	{
+		out[i] = (uint8_t)len;
+		len >>= 8;
+	}
+	return prefix;
+}
+
+//返回前缀字节数,数据不够时返回0,前缀错误返回-1
+static int frame_prefix_decode(int prefix,const uint8_t * head,int size,uint32_t * len)
+{
+	if(prefix == FRAME_PREFIX_VARINT)
+	{
+		uint32_t value = 0;
+		for(int i = 0;i < FRAME_PREFIX_MAX;i++)
+		{
+			if(i >= size)
+			{
+				return 0;
+			}
+			//第5字节只剩4位有效
+			if(i == FRAME_PREFIX_MAX - 1 && head[i] > 0x0F)
+			{
+				return -1;
+			}
+			value |= (uint32_t)(head[i] & 0x7F) << (7 * i);
+			if(!(head[i] & 0x80))
+			{
+				*len = value;
+				return i + 1;
+			}
+		}
+		return -1;
+	}
+	if(size < prefix)
+	{
+		return 0;
+	}
+	uint32_t value = 0;
+	for(int i = 0;i < prefix;i++)
+	{
+		value = (value << 8) | head[i];
+	}
+	*len = value;
+	return prefix;
+}
+
+int frame_decode(frame_decoder_t * f,loopqueue_t * q,frame_handler_pt handler,void * data)
+{
+	int count = 0;
+	while(1)
+	{
+		//队列里的数据最多两段: [r,尾) 和 [0,w)
+		uint32_t used = (uint32_t)queue_used(q);
+		if(used == 0)
+		{
+			break;
+		}
+		const uint8_t * first = (const uint8_t*)queue_r(q);
+		uint32_t first_size = (uint32_t)queue_rsize(q);
+		const uint8_t * second = q->data;
+		//前缀也可能跨过绕回点
+		uint8_t head[FRAME_PREFIX_MAX];
+		const uint8_t * head_ptr = first;
+		int head_size = used < FRAME_PREFIX_MAX ? (int)used : FRAME_PREFIX_MAX;
+		if(first_size < (uint32_t)head_size)
+		{
+			memcpy(head,first,first_size);
+			memcpy(head + first_size,second,head_size - first_size);
+			head_ptr = head;
+		}
+		uint32_t len = 0;
+		int n = frame_prefix_decode(f->prefix,head_ptr,head_size,&len);
+		if(n < 0 || len > f->max_frame)
+		{
+			LOGE("frame invalid prefix:%d len:%u max:%u\n",n,len,f->max_frame);
+			return -1;
+		}
+		if(n == 0 || used < n + len)
+		{
+			break;
+		}
+		const uint8_t * frame;
+		if(n + len <= first_size)
+		{
+			frame = first + n;
+		}else if((uint32_t)n >= first_size)
+		{
+			frame = second + (n - first_size);
+		}else{
+			//帧内容跨过绕回点,拼到临时缓冲区
+			if(f->scratch == NULL)
+			{
+				f->scratch = (uint8_t*)MALLOC_TAG(MEM_TAG_BUFFER,f->max_frame > 0 ? f->max_frame : 1);
+				if(f->scratch == NULL)
+				{
+					LOGE("frame scratch %u memory not enough\n",f->max_frame);
+					return -1;
+				}
+			}
+			uint32_t head_part = first_size - n;
+			memcpy(f->scratch,first + n,head_part);
+			memcpy(f->scratch + head_part,second,len - head_part);
+			frame = f->scratch;
+			f->copied++;
+		}
+		if(handler(data,frame,len) != 0)
+		{
+			break;
+		}
+		queue_rpushv(q,(int)(n + len));
+		f->frames++;
+		count++;
+	}
+	return count;
+}
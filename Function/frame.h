@@ -0,0 +1,33 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "loopqueue.h"
+
+//长度前缀分帧:前缀是varint或者1/2/4字节大端长度,后面跟帧内容
+//完整的帧以指向接收队列的指针交给处理函数,只有跨过绕回点的帧才复制到临时缓冲区拼起来
+
+#define FRAME_PREFIX_VARINT 0		//LEB128,最长5字节
+#define FRAME_PREFIX_MAX 5
+
+//frame只在调用期间有效,返回0继续,非0时停止并保留这一帧,下次frame_decode再交给处理函数
+typedef int (*frame_handler_pt)(void * data,const uint8_t * frame,uint32_t len);
+
+typedef struct frame_decoder_s{
+	int prefix;					//FRAME_PREFIX_VARINT或者前缀字节数1 2 4
+	uint32_t max_frame;			//帧长超过时frame_decode返回-1
+	uint8_t * scratch;			//拼接跨绕回的帧,第一次用到时分配max_frame
+	uint64_t frames;
+	uint64_t copied;			//拼接过的帧数
+}frame_decoder_t;
+
+int frame_decoder_init(frame_decoder_t * f,int prefix,uint32_t max_frame);
+void frame_decoder_done(frame_decoder_t * f);
+
+//取出队列中完整的帧依次交给handler,返回处理的帧数
+//帧长超过限制或前缀错误返回-1,流已经无法同步,调用者应关闭连接
+int frame_decode(frame_decoder_t * f,loopqueue_t * q,frame_handler_pt handler,void * data);
+
+//写出len的前缀,返回前缀字节数,前缀表示不了len时返回-1
+int frame_prefix_encode(int prefix,uint32_t len,uint8_t out[FRAME_PREFIX_MAX]);
+
+#endif
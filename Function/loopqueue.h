@@ -14,7 +14,7 @@ typedef struct loopqueue_s
 
 inline void queue_init(loopqueue_t * c,int size)
 {
-	c->data = MALLOC(size);
+	c->data = MALLOC_TAG(MEM_TAG_BUFFER,size);
 	c->size = size;
 	c->full = 0;
 	c->r_index = 0;
@@ -27,6 +27,37 @@ inline void queue_delete(loopqueue_t * c)
 	c->data  =NULL;
 }
 
+//使用外部缓冲区,queue_detach取回,不能再调用queue_delete
+inline void queue_attach(loopqueue_t * c,void * data,int size)
+{
+	c->data = (uint8_t*)data;
+	c->size = size;
+	c->full = 0;
+	c->r_index = 0;
+	c->w_index = 0;
+}
+
+inline void * queue_detach(loopqueue_t * c)
+{
+	void * data = c->data;
+	c->data = NULL;
+	c->size = 0;
+	c->full = 0;
+	c->r_index = 0;
+	c->w_index = 0;
+	return data;
+}
+
+//队列中的总字节数,包括绕回的部分
+inline int queue_used(loopqueue_t *c)
+{
+	if(c->full == 1)
+	{
+		return c->size;
+	}
+	return (c->w_index - c->r_index + c->size) % (c->size > 0 ? c->size : 1);
+}
+
 inline void * queue_w(loopqueue_t *c)
 {
 	if(c->full == 1)
@@ -174,4 +205,72 @@ inline void queue_rpush(loopqueue_t *c,int count)
 	}
 }
 
+//可写的空间,绕回时分成两段,返回段数
+inline int queue_wiov(loopqueue_t *c,socket_iovec_t iov[2])
+{
+	if(c->full == 1 || c->data == NULL)
+	{
+		return 0;
+	}
+	int n = 0;
+	socket_iovec_set(&iov[n],c->data + c->w_index,queue_wsize(c));
+	n++;
+	if(c->w_index >= c->r_index && c->r_index > 0)
+	{
+		socket_iovec_set(&iov[n],c->data,c->r_index);
+		n++;
+	}
+	return n;
+}
+
+//可读的数据,绕回时分成两段,返回段数
+inline int queue_riov(loopqueue_t *c,socket_iovec_t iov[2])
+{
+	int size = queue_rsize(c);
+	if(size <= 0)
+	{
+		return 0;
+	}
+	int n = 0;
+	socket_iovec_set(&iov[n],c->data + c->r_index,size);
+	n++;
+	if(c->r_index + size == c->size && c->w_index > 0 && c->w_index <= c->r_index)
+	{
+		socket_iovec_set(&iov[n],c->data,c->w_index);
+		n++;
+	}
+	return n;
+}
+
+//按段推进,count可以跨过绕回点
+inline void queue_wpushv(loopqueue_t *c,int count)
+{
+	while(count > 0)
+	{
+		int size = min(count,queue_wsize(c));
+		if(size <= 0)
+		{
+			LOGE("w_pushv too much size:r:%d w:%d c:%d\n",c->r_index,c->w_index,count);
+			break;
+		}
+		queue_wpush(c,size);
+		count -= size;
+	}
+}
+
+inline void queue_rpushv(loopqueue_t *c,int count)
+{
+	while(count > 0)
+	{
+		int size = min(count,queue_rsize(c));
+		if(size <= 0)
+		{
+			LOGE("r_pushv too much size:r:%d w:%d c:%d\n",c->r_index,c->w_index,count);
+			break;
+		}
+		queue_rpush(c,size);
+		count -= size;
+	}
+}
+
 #endif
@@ -0,0 +1,84 @@
+#include "mirrorqueue.h"
+
+#if (NGX_HAVE_MIRROR_QUEUE)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if (NGX_HAVE_MIRROR_QUEUE)
+static int mirrorqueue_memfd(const char * name)
+{
+#if defined(MFD_CLOEXEC)
+	return memfd_create(name,MFD_CLOEXEC);
+#elif defined(SYS_memfd_create)
+	return (int)syscall(SYS_memfd_create,name,1);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+#endif
+
+int mirrorqueue_init(mirrorqueue_t * q,uint32_t size)
+{
+	MEMZERO(q,sizeof(mirrorqueue_t));
+#if (NGX_HAVE_MIRROR_QUEUE)
+	uint32_t page = (uint32_t)sysconf(_SC_PAGESIZE);
+	uint32_t real = page;
+	while(real < size && real < 0x40000000)
+	{
+		real <<= 1;
+	}
+	int fd = mirrorqueue_memfd("mirrorqueue");
+	if(fd == -1)
+	{
+		LOGE("memfd_create errno:%d\n",errno);
+		return -1;
+	}
+	if(ftruncate(fd,real) != 0)
+	{
+		LOGE("ftruncate %u errno:%d\n",real,errno);
+		close(fd);
+		return -1;
+	}
+	//先占住两倍的地址空间,再把同一个文件固定映射到前后两半
+	uint8_t * base = (uint8_t*)mmap(NULL,(size_t)real * 2,PROT_NONE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+	if(base == MAP_FAILED)
+	{
+		LOGE("mmap reserve %u errno:%d\n",real * 2,errno);
+		close(fd);
+		return -1;
+	}
+	if(mmap(base,real,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_FIXED,fd,0) == MAP_FAILED
+		|| mmap(base + real,real,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_FIXED,fd,0) == MAP_FAILED)
+	{
+		LOGE("mmap mirror %u errno:%d\n",real,errno);
+		munmap(base,(size_t)real * 2);
+		close(fd);
+		return -1;
+	}
+	//映射建立后文件描述符不再需要
+	close(fd);
+	mem_stat_add(MEM_TAG_BUFFER,real);
+	q->data = base;
+	q->size = real;
+	q->mask = real - 1;
+	return 0;
+#else
+	LOGE("mirrorqueue not supported.\n");
+	return -1;
+#endif
+}
+
+void mirrorqueue_done(mirrorqueue_t * q)
+{
+#if (NGX_HAVE_MIRROR_QUEUE)
+	if(q->data != NULL)
+	{
+		munmap(q->data,(size_t)q->size * 2);
+		mem_stat_sub(MEM_TAG_BUFFER,q->size);
+	}
+#endif
+	MEMZERO(q,sizeof(mirrorqueue_t));
+}
@@ -0,0 +1,69 @@
+#ifndef MIRRORQUEUE_H
+#define MIRRORQUEUE_H
+
+#include "../Core/core.h"
+
+//loopqueue_t 的镜像内存版本:同一块物理内存在虚拟地址上连续映射两次
+//从任意位置开始、不超过size的读写区间都是连续的,不需要处理绕回
+//大小为页的整数倍且是2的幂,下标只增不减,用掩码取模
+//目前只支持Linux(memfd_create),其他平台mirrorqueue_init返回-1,调用者改用loopqueue_t
+
+#if defined(__linux__)
+#define NGX_HAVE_MIRROR_QUEUE 1
+#endif
+
+typedef struct mirrorqueue_s
+{
+	uint8_t *data;			//映射两次,长度为2*size
+	uint32_t size;
+	uint32_t mask;
+	uint32_t r_index;		//自由增长,取数据时&mask
+	uint32_t w_index;
+}mirrorqueue_t;
+
+//size向上取整到页大小的2的幂,失败返回-1
+int mirrorqueue_init(mirrorqueue_t * q,uint32_t size);
+void mirrorqueue_done(mirrorqueue_t * q);
+
+#define mirrorqueue_used(q)		((q)->w_index - (q)->r_index)
+#define mirrorqueue_empty(q)	((q)->w_index == (q)->r_index)
+
+static inline void * mirrorqueue_w(mirrorqueue_t * q)
+{
+	return q->data + (q->w_index & q->mask);
+}
+
+static inline uint32_t mirrorqueue_wsize(mirrorqueue_t * q)
+{
+	return q->size - mirrorqueue_used(q);
+}
+
+static inline void mirrorqueue_wpush(mirrorqueue_t * q,uint32_t count)
+{
+	ASSERT(count <= mirrorqueue_wsize(q));
+	q->w_index += count;
+}
+
+static inline void * mirrorqueue_r(mirrorqueue_t * q)
+{
+	return q->data + (q->r_index & q->mask);
+}
+
+static inline uint32_t mirrorqueue_rsize(mirrorqueue_t * q)
+{
+	return mirrorqueue_used(q);
+}
+
+static inline void mirrorqueue_rpush(mirrorqueue_t * q,uint32_t count)
+{
+	ASSERT(count <= mirrorqueue_rsize(q));
+	q->r_index += count;
+	//读空时下标归零,保持数值较小,方便调试
+	if(q->r_index == q->w_index)
+	{
+		q->r_index = 0;
+		q->w_index = 0;
+	}
+}
+
+#endif
@@ -0,0 +1,211 @@
+#include "../Module/module.h"
+#include "output.h"
+#include "echo.h"
+
+//没有加入事件模块的连接(比如client只用定时器驱动)不能修改关注的事件,积压的数据等下次写时再发
+#define output_registered(c) ((c)->event != 0 || (c)->read_paused)
+
+static int output_send(connection_t * c,int flags);
+
+static void output_flush_handler(event_t * ev)
+{
+	connection_output_t * out = (connection_output_t*)ev->data;
+	connection_flush(out->c);
+}
+
+static int output_borrow(connection_output_t * out,size_t len)
+{
+	if(out->queue.data != NULL)
+	{
+		return 0;
+	}
+	int cls = buffer_class_fit(len);
+	if(cls < out->cls) cls = out->cls;
+	void * data = buffer_pool_alloc(&out->c->cycle->buffer_pool,cls);
+	if(data == NULL)
+	{
+		return -1;
+	}
+	out->cls = cls;
+	queue_attach(&out->queue,data,(int)buffer_class_size(cls));
+	if(output_registered(out->c))
+	{
+		connection_watermark_set(out->c,(uint32_t)buffer_class_size(cls),(uint32_t)buffer_class_size(cls) / 2);
+	}
+	return 0;
+}
+
+static void output_return(connection_output_t * out)
+{
+	if(out->queue.data == NULL)
+	{
+		return;
+	}
+	buffer_pool_free(&out->c->cycle->buffer_pool,out->cls,queue_detach(&out->queue));
+}
+
+//连接释放时丢弃还没发出的数据
+static void output_cleanup(void * data)
+{
+	connection_output_t * out = (connection_output_t*)data;
+	if(out->flush.posted)
+	{
+		ngx_delete_posted_event(&out->flush);
+	}
+	output_return(out);
+}
+
+static connection_output_t * output_get(connection_t * c)
+{
+	if(c->output != NULL)
+	{
+		return c->output;
+	}
+	ngx_pool_t * pool = connection_pool(c);
+	if(pool == NULL)
+	{
+		return NULL;
+	}
+	ngx_pool_cleanup_t * cln = ngx_pool_cleanup_add(pool,0);
+	connection_output_t * out = (connection_output_t*)ngx_pcalloc(pool,sizeof(connection_output_t));
+	if(cln == NULL || out == NULL)
+	{
+		return NULL;
+	}
+	out->c = c;
+	queue_detach(&out->queue);
+	event_init(&out->flush,output_flush_handler,out);
+	cln->handler = output_cleanup;
+	cln->data = out;
+	c->output = out;
+	return out;
+}
+
+int connection_write(connection_t * c,const void * buf,size_t len)
+{
+	connection_output_t * out = output_get(c);
+	if(out == NULL || output_borrow(out,len) != 0)
+	{
+		LOGE("connection output failed:%d\n",c->so.handle);
+		connection_remove(c);
+		return -1;
+	}
+	size_t done = 0;
+	while(done < len)
+	{
+		uint8_t * w = (uint8_t*)queue_w(&out->queue);
+		if(w == NULL)
+		{
+			//队列满了,先发出去腾地方,发不出去时返回已复制的部分
+			//后面还有数据,带MSG_MORE让内核等凑满再发,本轮的flush不带标记时一起推出去
+			int pending = output_send(c,SOCKET_MSG_MORE);
+			if(pending < 0)
+			{
+				return -1;
+			}
+			if(out->queue.data == NULL && output_borrow(out,len - done) != 0)
+			{
+				break;
+			}
+			if(queue_w(&out->queue) == NULL)
+			{
+				break;
+			}
+			continue;
+		}
+		size_t size = (size_t)queue_wsize(&out->queue);
+		if(size > len - done) size = len - done;
+		memcpy(w,(const uint8_t*)buf + done,size);
+		queue_wpush(&out->queue,(int)size);
+		done += size;
+	}
+	int pending = queue_used(&out->queue);
+	if(pending > 0 && !out->flush.posted)
+	{
+		ngx_post_event(&out->flush,&c->cycle->flush_posted);
+	}
+	connection_watermark(c,pending);
+	return (int)done;
+}
+
+static int output_send(connection_t * c,int flags)
+{
+	connection_output_t * out = c->output;
+	if(out == NULL)
+	{
+		return 0;
+	}
+	if(out->flush.posted)
+	{
+		ngx_delete_posted_event(&out->flush);
+	}
+	//队列最多两段,一次系统调用发出
+	while(1)
+	{
+		socket_iovec_t iov[2];
+		int count = queue_riov(&out->queue,iov);
+		if(count == 0)
+		{
+			break;
+		}
+		int ret = buffer_sendv(c,iov,count,flags);
+		if(ret < 0)
+		{
+			return -1;
+		}
+		if(ret == 0)
+		{
+			//发送缓冲区满,可写时由服务的写事件处理继续发送
+			c->so.write->ready = 0;
+			if(output_registered(c)) connection_cycle_mod(c,NGX_READ_EVENT | NGX_WRITE_EVENT);
+			break;
+		}
+		queue_rpushv(&out->queue,ret);
+	}
+	int pending = queue_used(&out->queue);
+	if(pending == 0)
+	{
+		output_return(out);
+		//水平触发时不再关注写事件
+		if(c->event & NGX_WRITE_EVENT) connection_cycle_mod(c,NGX_READ_EVENT);
+	}
+	connection_watermark(c,pending);
+	return pending;
+}
+
+int connection_flush(connection_t * c)
+{
+	return output_send(c,0);
+}
+
+int connection_output_pending(connection_t * c)
+{
+	return c->output != NULL ? queue_used(&c->output->queue) : 0;
+}
+
+int connection_output_reserve(connection_t * c,size_t len)
+{
+	connection_output_t * out = output_get(c);
+	if(out == NULL)
+	{
+		return -1;
+	}
+	if(out->queue.data != NULL && (size_t)(out->queue.size - queue_used(&out->queue)) < len)
+	{
+		//接下来要写入len,同样带MSG_MORE
+		if(output_send(c,SOCKET_MSG_MORE) < 0)
+		{
+			return -1;
+		}
+	}
+	//空队列的缓冲区太小时换大一级
+	if(out->queue.data != NULL && queue_used(&out->queue) == 0 && (size_t)out->queue.size < len)
+	{
+		output_return(out);
+	}
+	if(out->queue.data == NULL && output_borrow(out,len) != 0)
+	{
+		return -1;
+	}
+	return out->queue.size - queue_used(&out->queue);
+}
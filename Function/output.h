@@ -0,0 +1,30 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "../Module/connection.h"
+#include "loopqueue.h"
+
+//按tick合并的输出:connection_write 只把数据复制进连接的输出队列
+//同一轮循环里对一个连接的多次写,在cycle的step阶段合成一次发出,延迟不超过一轮
+//一轮里写入超过队列大小时中途先发出一部分,这些发送带MSG_MORE,最后一次不带标记把数据推出去
+//发送缓冲区满时剩余数据留在队列里并关注写事件,服务的写事件处理里调用connection_flush继续发送
+//队列超过高水位时暂停读(connection_watermark)
+
+typedef struct connection_output_s{
+	connection_t * c;
+	loopqueue_t queue;		//有数据时从cycle借用缓冲区,发空后归还
+	int cls;
+	event_t flush;			//投递到cycle->flush_posted
+}connection_output_t;
+
+//返回复制进队列的字节数,队列满时可能小于len或为0,连接出错返回-1,和buffer_write一样
+int connection_write(connection_t * c,const void * buf,size_t len);
+//立即发送队列中的数据,返回队列中剩下的字节数,出错返回-1
+int connection_flush(connection_t * c);
+//队列中待发送的字节数
+int connection_output_pending(connection_t * c);
+//要写入的内容不能拆开时先调用:返回队列能写入的字节数,不小于len时接下来的connection_write不会只写一部分
+//小于len时要等写事件,出错返回-1
+int connection_output_reserve(connection_t * c,size_t len);
+
+#endif
@@ -1,7 +1,61 @@
 #include "service.h"
 #include "echo.h"
 
+typedef struct service_s{
+	const char * name;
+	void (*init)(connection_t * c);
+	datagram_handler_pt datagram;	//不为NULL时是UDP服务
+	int defer_accept;				//监听参数,0表示保持系统默认
+	int fastopen;
+}service_t;
+
+static service_t g_service[] = {
+	//echo的客户端连上就发数据,没有数据的连接不必唤醒accept
+	{"echo",echo_init,NULL,1,256},
+	{"splice",echo_splice_init,NULL,0,0},
+	{"zerocopy",echo_zerocopy_init,NULL,0,0},
+	{"frame",echo_frame_init,NULL,0,0},
+	{"udp",echo_init,echo_datagram_handler,0,0},
+	{NULL,NULL,NULL,0,0}
+};
+
+static service_t * g_service_current = &g_service[0];
+
+int service_select(const char * name)
+{
+	if(name == NULL)
+	{
+		return 0;
+	}
+	for(int i = 0;g_service[i].name != NULL;i++)
+	{
+		if(strcmp(name,g_service[i].name) == 0)
+		{
+			g_service_current = &g_service[i];
+			return 0;
+		}
+	}
+	LOGE("unknown service:%s\n",name);
+	return -1;
+}
+
+const char * service_name()
+{
+	return g_service_current->name;
+}
+
 void service_init(connection_t * c)
 {
-	echo_init(c);
+	g_service_current->init(c);
+}
+
+datagram_handler_pt service_datagram()
+{
+	return g_service_current->datagram;
+}
+
+void service_listen_conf(socket_listen_conf_t * conf)
+{
+	conf->defer_accept = g_service_current->defer_accept;
+	conf->fastopen = g_service_current->fastopen;
 }
@@ -2,7 +2,16 @@
 #define SERVICE_H
 
 #include "../Module/connection.h"
+#include "../Module/datagram.h"
+
+//按名字选择连接上运行的服务: echo splice zerocopy frame udp,NULL为echo
+int service_select(const char * name);
+const char * service_name();
 
 void service_init(connection_t * c);
+//UDP服务收到数据报的处理函数,TCP服务返回NULL
+datagram_handler_pt service_datagram();
+//设置当前服务的监听参数
+void service_listen_conf(socket_listen_conf_t * conf);
 
 #endif
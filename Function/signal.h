@@ -20,6 +20,7 @@ static void signal_handle_term(int sig)
 			slave_stop(slave);
 		}
 		cycle->stop = 1;
+		cycle_wakeup(cycle);
 	}
 }
 
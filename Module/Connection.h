@@ -6,31 +6,109 @@
 
 typedef struct connection_s{
 	socket_t so;
+	//so.read/write/error 默认指向这里
+	event_t read;
+	event_t write;
+	event_t error;
 	cycle_t * cycle;
 	ngx_queue_t queue;
+	//当前在事件模块中关注的事件
+	int event;
+	int flags;
+	//输出积压的高低水位,超过high_water暂停读,降到low_water以下恢复,high_water为0时不限制
+	uint32_t high_water;
+	uint32_t low_water;
+	int read_paused;
+	//connection_remove请求过关闭,服务的错误事件处理据此和事件模块报告的错误区分
+	int closing;
+	//移交给其他cycle时使用
+	safe_event_t post;
+	//从哪个cycle的对象池分配,NULL表示直接分配
+	cycle_t * owner;
+	//连接生命周期内的内存,第一次使用时创建,connection_destroy时整体释放
+	ngx_pool_t * pool;
+	//零拷贝发送的状态,connection_zerocopy_enable 时创建
+	struct connection_zerocopy_s * zerocopy;
+	//按tick合并的输出队列,第一次connection_write时创建
+	struct connection_output_s * output;
 }connection_t;
 
-static inline connection_t * connection_create(cycle_t * cycle,SOCKET s)
+//连接内存池每块大小
+#define CONNECTION_POOL_SIZE 512
+
+//从pool所属cycle的对象池分配,只能在pool所属线程调用,连接可以交给其他cycle使用
+static inline connection_t * connection_create_(cycle_t * owner,cycle_t * cycle,SOCKET s)
 {
-	connection_t * conn = MALLOC(sizeof(connection_t));
+	connection_t * conn = (connection_t*)object_pool_alloc(&owner->connection_pool,sizeof(connection_t));
+	if(conn == NULL)
+	{
+		conn = (connection_t*)MALLOC_TAG(MEM_TAG_CONNECTION,sizeof(connection_t));
+		owner = NULL;
+	}
+	conn->owner = owner;
+	conn->pool = NULL;
+	conn->zerocopy = NULL;
+	conn->output = NULL;
 	conn->so.handle = s;
-	conn->so.read = NULL;
-	conn->so.write = NULL;
-	conn->so.error = NULL;
+	event_init(&conn->read,NULL,conn);
+	event_init(&conn->write,NULL,conn);
+	event_init(&conn->error,NULL,conn);
+	conn->so.read = &conn->read;
+	conn->so.write = &conn->write;
+	conn->so.error = &conn->error;
 	conn->cycle = cycle;
 	ngx_queue_init(&conn->queue);
+	conn->event = 0;
+	conn->flags = 0;
+	conn->high_water = 0;
+	conn->low_water = 0;
+	conn->read_paused = 0;
+	conn->closing = 0;
+	safe_event_init(&conn->post,NULL,conn);
 	return conn;
 }
 
+static inline connection_t * connection_create(cycle_t * cycle,SOCKET s)
+{
+	return connection_create_(cycle,cycle,s);
+}
+
+//服务用它分配和连接同生命周期的内存,释放时的清理用 ngx_pool_cleanup_add 注册
+static inline ngx_pool_t * connection_pool(connection_t * c)
+{
+	if(c->pool == NULL)
+	{
+		c->pool = ngx_create_pool(CONNECTION_POOL_SIZE);
+	}
+	return c->pool;
+}
+
+//事件不是内嵌的才单独释放
+#define connection_event_destroy(c,ev) if((c)->so.ev != &(c)->ev) event_destroy(&(c)->so.ev);
+
 static inline void connection_destroy(connection_t** conn){
 	if(conn != NULL)
 	{
 		if(*conn != NULL){
 			connection_t* c = *conn;
-			event_destroy(&c->so.read);
-			event_destroy(&c->so.write);
-			event_destroy(&c->so.error);
-			FREE(c);
+			if(c->pool != NULL)
+			{
+				ngx_destroy_pool(c->pool);
+				c->pool = NULL;
+			}
+			connection_event_destroy(c,read);
+			connection_event_destroy(c,write);
+			connection_event_destroy(c,error);
+			if(c->owner == NULL)
+			{
+				FREE(c);
+			}else if(c->owner == c->cycle)
+			{
+				object_pool_free(&c->owner->connection_pool,c);
+			}else{
+				//在其他cycle分配的,放回对方的远程链表
+				object_pool_free_remote(&c->owner->connection_pool,c);
+			}
 		}
 		*conn = NULL;
 	}
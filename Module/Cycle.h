@@ -3,6 +3,18 @@
 
 #include "../Event/EventActions.h"
 #include "ngx_event_timer.h"
+#include "ngx_event_wheel.h"
+#include "Stat.h"
+
+#if defined(__linux__)
+#define NGX_HAVE_EVENTFD 1
+#include <sys/eventfd.h>
+#endif
+
+//有门铃时空闲cycle最长阻塞时间
+#define CYCLE_IDLE_TIMEOUT 1000
+//统计线程CPU占用的周期(毫秒)
+#define CYCLE_LOAD_PERIOD 100
 
 struct cycle_s;
 
@@ -16,6 +28,34 @@ typedef struct cycle_ptr{
 	cycle_func end;
 }cycle_ptr;
 
+typedef struct safe_event_s safe_event_t;
+
+typedef void (*safe_event_handle_pt)(struct cycle_s * cycle,safe_event_t *sev);
+
+//跨线程投递到cycle的消息,由调用者嵌入到自己的结构中
+struct safe_event_s{
+	mpsc_node_t node;
+	safe_event_handle_pt handler;
+	void * data;
+};
+
+static inline void safe_event_init(safe_event_t *sev,safe_event_handle_pt handler,void * data)
+{
+	sev->node.next = NULL;
+	sev->handler = handler;
+	sev->data = data;
+}
+
+//负载信息,由cycle自己的线程写,其他线程不加锁读取
+typedef struct cycle_load_s{
+	volatile uint32_t connections;
+	volatile uint32_t busy;			//线程占用CPU的千分比,平滑过
+	ngx_atomic_t backlog;			//已投递还没处理的消息数
+	//以下只有cycle自己使用
+	ngx_msec_t time;
+	uint64_t cpu;
+}cycle_load_t;
+
 typedef struct cycle_s{
 	core_t * core;
 	int stop;
@@ -26,20 +66,97 @@ typedef struct cycle_s{
 	uint32_t connection_count;
 	ngx_queue_t internal_posted;
 
+	//稀疏、需要精确到期的定时器
 	ngx_rbtree_t timeout;
+	//大量短周期定时器,如连接的读写超时
+	ngx_event_wheel_t wheel;
 	ngx_queue_t posted;
+	//本轮有合并输出待发送的连接,在step阶段统一发出
+	ngx_queue_t flush_posted;
+
+	//其他线程投递的消息
+	mpsc_queue_t async_posted;
+	//投递消息时唤醒阻塞在事件模块里的cycle,没有时handle为-1
+	socket_t doorbell;
+	event_t doorbell_event;
 
-	ngx_queue_t async_posted;
-	ngx_atomic_t async_posted_lock;
-	ngx_atomic_t async_posted_count;
+	cycle_load_t load;
+	cycle_stat_block_t stat;
+
+	//connection_t 对象池,上限为concurrent
+	object_pool_t connection_pool;
+	//连接收发数据时借用的缓冲区
+	buffer_pool_t buffer_pool;
 
 	void * data;
 	cycle_ptr * ptr;
 }cycle_t;
 
+static inline void cycle_doorbell_handler(event_t *ev)
+{
+#if (NGX_HAVE_EVENTFD)
+	cycle_t * cycle = (cycle_t*)ev->data;
+	uint64_t count;
+	//计数清零,消息在本轮的safe_process_event中处理
+	while(read(cycle->doorbell.handle,&count,sizeof(count)) == sizeof(count));
+#endif
+}
+
+static inline void cycle_doorbell_init(cycle_t * cycle)
+{
+	cycle->doorbell.handle = -1;
+	cycle->doorbell.read = &cycle->doorbell_event;
+	cycle->doorbell.write = NULL;
+	cycle->doorbell.error = &cycle->doorbell_event;
+	event_init(&cycle->doorbell_event,cycle_doorbell_handler,cycle);
+#if (NGX_HAVE_EVENTFD)
+	if(cycle->core == NULL) return;
+	int fd = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+	if(fd == -1)
+	{
+		LOGE("eventfd errno:%d\n",errno);
+		return;
+	}
+	cycle->doorbell.handle = fd;
+	if(action_add(cycle->core,&cycle->doorbell,NGX_READ_EVENT,0) != 0)
+	{
+		LOGE("doorbell action_add errno:%d\n",errno);
+		close(fd);
+		cycle->doorbell.handle = -1;
+	}
+#endif
+}
+
+static inline void cycle_doorbell_done(cycle_t * cycle)
+{
+	if(cycle->doorbell.handle != -1)
+	{
+		action_del(cycle->core,&cycle->doorbell);
+		close(cycle->doorbell.handle);
+		cycle->doorbell.handle = -1;
+	}
+}
+
+#define cycle_has_doorbell(cycle) ((cycle)->doorbell.handle != -1)
+
+//任意线程调用,包括信号处理函数
+static inline void cycle_wakeup(cycle_t * cycle)
+{
+#if (NGX_HAVE_EVENTFD)
+	if(cycle_has_doorbell(cycle))
+	{
+		uint64_t one = 1;
+		if(write(cycle->doorbell.handle,&one,sizeof(one)) != sizeof(one) && errno != EAGAIN)
+		{
+			LOGE("doorbell write errno:%d\n",errno);
+		}
+	}
+#endif
+}
+
 static inline cycle_t * cycle_create(int concurrent,cycle_ptr * ptr)
 {
-	cycle_t * cycle = MALLOC(sizeof(cycle_t));
+	cycle_t * cycle = MALLOC_TAG(MEM_TAG_CYCLE,sizeof(cycle_t));
 	cycle->stop = 0;
 	cycle->index = -1;
 	cycle->master = 1;
@@ -51,10 +168,16 @@ static inline cycle_t * cycle_create(int concurrent,cycle_ptr * ptr)
 	ngx_queue_init(&cycle->internal_posted);
 
 	ngx_event_timer_init(&cycle->timeout);
+	ngx_event_wheel_init(&cycle->wheel);
 	ngx_queue_init(&cycle->posted);
-	ngx_queue_init(&cycle->async_posted);
-	cycle->async_posted_lock = 0;
-	cycle->async_posted_count = 0;
+	ngx_queue_init(&cycle->flush_posted);
+	mpsc_queue_init(&cycle->async_posted);
+	cycle_doorbell_init(cycle);
+	MEMZERO(&cycle->load,sizeof(cycle_load_t));
+	MEMZERO(&cycle->stat,sizeof(cycle_stat_block_t));
+	object_pool_init(&cycle->connection_pool,concurrent > 0 ? concurrent : 0);
+	cycle->connection_pool.tag = MEM_TAG_CONNECTION;
+	buffer_pool_init(&cycle->buffer_pool);
 	
 	cycle->data = NULL;
 	cycle->ptr = ptr;
@@ -69,13 +192,39 @@ static inline void cycle_destroy(cycle_t ** cycle_ptr)
 		{
 			cycle_t * cycle = *cycle_ptr;
 			cycle->stop = 1;
+			cycle_doorbell_done(cycle);
 			action_done(cycle->core);
+			object_pool_done(&cycle->connection_pool);
+			buffer_pool_done(&cycle->buffer_pool);
 			FREE(cycle);
 			*cycle_ptr = NULL;
 		}
 	}
 }
 
+#define cycle_load_score(cycle) ((ngx_atomic_int_t)(cycle)->load.connections + (ngx_atomic_int_t)(cycle)->load.backlog)
+
+//每轮循环调用,CPU时间按周期采样,避免每轮一次系统调用
+static inline void cycle_load_update(cycle_t * cycle)
+{
+	cycle_load_t * load = &cycle->load;
+	load->connections = cycle->connection_count;
+	ngx_msec_t elapsed = ngx_current_msec - load->time;
+	if(elapsed < CYCLE_LOAD_PERIOD)
+	{
+		return;
+	}
+	uint64_t cpu = time_thread_cpu_nanosecond();
+	if(load->time != 0)
+	{
+		uint64_t busy = (cpu - load->cpu) / elapsed / 1000;
+		if(busy > 1000) busy = 1000;
+		load->busy = (uint32_t)((load->busy * 3 + busy) / 4);
+	}
+	load->time = ngx_current_msec;
+	load->cpu = cpu;
+}
+
 static inline void cycle_process_init(cycle_t * cycle)
 {
 	if(cycle != NULL && cycle->ptr != NULL && cycle->ptr->init != NULL)
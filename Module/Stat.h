@@ -0,0 +1,187 @@
+#ifndef STAT_H
+#define STAT_H
+
+#include "../Core/core.h"
+
+//事件循环各阶段耗时统计,-DNGX_NO_CYCLE_STAT 关闭
+#if !defined(NGX_NO_CYCLE_STAT)
+#define NGX_CYCLE_STAT 1
+#endif
+
+//按2的幂分桶,第i个桶记录 [2^(i-1),2^i) 的值
+#define STAT_BUCKETS 40
+//读快照时最多重试次数
+#define STAT_SNAPSHOT_RETRY 16
+
+typedef struct stat_histogram_s{
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint64_t buckets[STAT_BUCKETS];
+}stat_histogram_t;
+
+enum{
+	CYCLE_PHASE_ACTION = 0,		//action_process,包括等待和事件回调
+	CYCLE_PHASE_TIMER,			//ngx_event_expire_timers
+	CYCLE_PHASE_SAFE,			//safe_process_event
+	CYCLE_PHASE_POSTED,			//posted
+	CYCLE_PHASE_INTERNAL,		//internal_posted
+	CYCLE_PHASE_STEP,			//step回调
+	CYCLE_PHASE_COUNT
+};
+
+typedef struct cycle_stat_s{
+	stat_histogram_t phase[CYCLE_PHASE_COUNT];	//纳秒
+	stat_histogram_t events;					//每轮事件模块返回的事件数
+	stat_histogram_t lag;						//每轮超出预定等待时间的部分,纳秒
+	uint64_t ticks;
+}cycle_stat_t;
+
+//cycle自己的线程写,其他线程通过seq读一致的快照
+typedef struct cycle_stat_block_s{
+	volatile uint32_t seq;
+	cycle_stat_t stat;
+	//以下只有cycle自己使用,一轮结束时才写入stat,seq为奇数的时间很短
+	uint64_t tick_begin;
+	uint64_t phase_begin;
+	uint64_t phase[CYCLE_PHASE_COUNT];
+	int events;
+}cycle_stat_block_t;
+
+static inline const char * cycle_phase_name(int phase)
+{
+	static const char * names[CYCLE_PHASE_COUNT] = {"action","timer","safe","posted","internal","step"};
+	return phase >= 0 && phase < CYCLE_PHASE_COUNT ? names[phase] : "unknown";
+}
+
+static inline int stat_bucket(uint64_t value)
+{
+	int i = 0;
+	while(value != 0 && i < STAT_BUCKETS - 1)
+	{
+		value >>= 1;
+		i++;
+	}
+	return i;
+}
+
+static inline void stat_histogram_add(stat_histogram_t *h,uint64_t value)
+{
+	h->count++;
+	h->sum += value;
+	if(value > h->max) h->max = value;
+	h->buckets[stat_bucket(value)]++;
+}
+
+static inline void stat_histogram_merge(stat_histogram_t *dst,const stat_histogram_t *src)
+{
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if(src->max > dst->max) dst->max = src->max;
+	for(int i = 0;i < STAT_BUCKETS;i++)
+	{
+		dst->buckets[i] += src->buckets[i];
+	}
+}
+
+//返回所在桶的上界,percent取0-100
+static inline uint64_t stat_histogram_percentile(const stat_histogram_t *h,int percent)
+{
+	if(h->count == 0) return 0;
+	uint64_t target = (h->count * percent + 99) / 100;
+	uint64_t n = 0;
+	for(int i = 0;i < STAT_BUCKETS;i++)
+	{
+		n += h->buckets[i];
+		if(n >= target && n > 0)
+		{
+			uint64_t bound = i == 0 ? 0 : ((uint64_t)1 << i) - 1;
+			return bound < h->max ? bound : h->max;
+		}
+	}
+	return h->max;
+}
+
+static inline void cycle_stat_merge(cycle_stat_t *dst,const cycle_stat_t *src)
+{
+	for(int i = 0;i < CYCLE_PHASE_COUNT;i++)
+	{
+		stat_histogram_merge(&dst->phase[i],&src->phase[i]);
+	}
+	stat_histogram_merge(&dst->events,&src->events);
+	stat_histogram_merge(&dst->lag,&src->lag);
+	dst->ticks += src->ticks;
+}
+
+#if (NGX_CYCLE_STAT)
+
+static inline void cycle_stat_begin(cycle_stat_block_t *block)
+{
+	block->tick_begin = time_monotonic_nanosecond();
+	block->phase_begin = block->tick_begin;
+	block->events = 0;
+}
+
+static inline void cycle_stat_phase(cycle_stat_block_t *block,int phase)
+{
+	uint64_t now = time_monotonic_nanosecond();
+	block->phase[phase] = now - block->phase_begin;
+	block->phase_begin = now;
+}
+
+static inline void cycle_stat_events(cycle_stat_block_t *block,int events)
+{
+	block->events = events > 0 ? events : 0;
+}
+
+//一轮结束,timeout为本轮预定的等待时间(毫秒)
+static inline void cycle_stat_end(cycle_stat_block_t *block,ngx_msec_t timeout)
+{
+	uint64_t used = block->phase_begin - block->tick_begin;
+	uint64_t expect = (uint64_t)timeout * 1000000;
+	block->seq++;
+	ngx_memory_barrier();
+	for(int i = 0;i < CYCLE_PHASE_COUNT;i++)
+	{
+		stat_histogram_add(&block->stat.phase[i],block->phase[i]);
+		block->phase[i] = 0;
+	}
+	stat_histogram_add(&block->stat.events,block->events);
+	stat_histogram_add(&block->stat.lag,used > expect ? used - expect : 0);
+	block->stat.ticks++;
+	ngx_memory_barrier();
+	block->seq++;
+}
+
+#else
+
+#define cycle_stat_begin(block)
+#define cycle_stat_phase(block,phase)
+#define cycle_stat_events(block,events)
+#define cycle_stat_end(block,timeout)
+
+#endif
+
+//任意线程调用,不阻塞写入方,拿不到一致的快照时返回-1
+static inline int cycle_stat_snapshot(cycle_stat_block_t *block,cycle_stat_t *out)
+{
+	for(int i = 0;i < STAT_SNAPSHOT_RETRY;i++)
+	{
+		uint32_t seq = block->seq;
+		if(seq & 1)
+		{
+			ngx_cpu_pause();
+			continue;
+		}
+		ngx_memory_barrier();
+		memcpy(out,(const void*)&block->stat,sizeof(cycle_stat_t));
+		ngx_memory_barrier();
+		if(block->seq == seq)
+		{
+			return 0;
+		}
+	}
+	return -1;
+}
+
+#endif
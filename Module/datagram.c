@@ -0,0 +1,371 @@
+#include "module.h"
+#include "datagram.h"
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif
+
+//每个数据报的辅助数据,只用到GRO/GSO的分段长度
+#define DATAGRAM_CONTROL 64
+
+typedef struct datagram_buffer_s{
+	void * data;
+}datagram_buffer_t;
+
+static void datagram_cleanup(void * data)
+{
+	datagram_buffer_t * b = (datagram_buffer_t*)data;
+	FREE(b->data);
+	b->data = NULL;
+}
+
+//返回收到的数据报数,没有数据时返回0,出错返回-1
+static int datagram_recv(connection_datagram_t * d)
+{
+	int count = 0;
+#if (NGX_HAVE_MMSG)
+	for(int i = 0;i < d->batch;i++)
+	{
+		struct msghdr * h = &d->hdr[i].msg_hdr;
+		socket_iovec_set(&d->iov[i],d->rmsgs[i].data,d->size);
+		h->msg_name = &d->rmsgs[i].addr;
+		h->msg_namelen = sizeof(struct sockaddr_storage);
+		h->msg_iov = &d->iov[i];
+		h->msg_iovlen = 1;
+		h->msg_control = d->gro ? d->control + i * DATAGRAM_CONTROL : NULL;
+		h->msg_controllen = d->gro ? DATAGRAM_CONTROL : 0;
+		h->msg_flags = 0;
+	}
+	int n = recvmmsg(d->c->so.handle,d->hdr,d->batch,MSG_DONTWAIT,NULL);
+	if(n < 0)
+	{
+		return _ERRNO == _ERROR(EWOULDBLOCK) ? 0 : -1;
+	}
+	for(int i = 0;i < n;i++)
+	{
+		struct msghdr * h = &d->hdr[i].msg_hdr;
+		//截断的跳过,后面的往前挪,和跳过的互换,缓冲区仍然各占一块
+		if(h->msg_flags & MSG_TRUNC)
+		{
+			d->dropped++;
+			continue;
+		}
+		datagram_msg_t * m = &d->rmsgs[count];
+		if(count != i)
+		{
+			datagram_msg_t tmp = *m;
+			*m = d->rmsgs[i];
+			d->rmsgs[i] = tmp;
+		}
+		m->addrlen = h->msg_namelen;
+		m->len = d->hdr[i].msg_len;
+		m->segment = 0;
+#if (NGX_HAVE_UDP_GRO)
+		for(struct cmsghdr * cm = CMSG_FIRSTHDR(h);cm != NULL;cm = CMSG_NXTHDR(h,cm))
+		{
+			if(cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+			{
+				int segment = 0;
+				memcpy(&segment,CMSG_DATA(cm),sizeof(int));
+				if(segment > 0 && (uint32_t)segment < m->len) m->segment = segment;
+			}
+		}
+#endif
+		d->rx += datagram_segments(m);
+		count++;
+	}
+	return count;
+#else
+	while(count < d->batch)
+	{
+		datagram_msg_t * m = &d->rmsgs[count];
+		m->addrlen = sizeof(struct sockaddr_storage);
+		int ret = recvfrom(d->c->so.handle,(char*)m->data,d->size,0,(struct sockaddr*)&m->addr,&m->addrlen);
+		if(ret < 0)
+		{
+			if(_ERRNO == _ERROR(EWOULDBLOCK)) break;
+			return count > 0 ? count : -1;
+		}
+		m->len = ret;
+		m->segment = 0;
+		d->rx++;
+		count++;
+	}
+	return count;
+#endif
+}
+
+//发出前n个,返回发出的个数,发送缓冲区满时返回0,第一个发送失败时返回-1
+static int datagram_sendv(connection_datagram_t * d,int n)
+{
+#if (NGX_HAVE_MMSG)
+	for(int i = 0;i < n;i++)
+	{
+		datagram_msg_t * m = &d->wmsgs[i];
+		struct msghdr * h = &d->hdr[i].msg_hdr;
+		socket_iovec_set(&d->iov[i],m->data,m->len);
+		h->msg_name = m->addrlen > 0 ? &m->addr : NULL;
+		h->msg_namelen = m->addrlen;
+		h->msg_iov = &d->iov[i];
+		h->msg_iovlen = 1;
+		h->msg_control = NULL;
+		h->msg_controllen = 0;
+		h->msg_flags = 0;
+#if (NGX_HAVE_UDP_GSO)
+		if(m->segment > 0)
+		{
+			//内核按segment切成多个数据报,一次协议栈处理
+			h->msg_control = d->control + i * DATAGRAM_CONTROL;
+			h->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+			struct cmsghdr * cm = CMSG_FIRSTHDR(h);
+			cm->cmsg_level = SOL_UDP;
+			cm->cmsg_type = UDP_SEGMENT;
+			cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			uint16_t segment = (uint16_t)m->segment;
+			memcpy(CMSG_DATA(cm),&segment,sizeof(uint16_t));
+		}
+#endif
+	}
+	int ret = sendmmsg(d->c->so.handle,d->hdr,n,MSG_DONTWAIT);
+	if(ret < 0)
+	{
+		return _ERRNO == _ERROR(EWOULDBLOCK) ? 0 : -1;
+	}
+	return ret;
+#else
+	int count = 0;
+	for(;count < n;count++)
+	{
+		datagram_msg_t * m = &d->wmsgs[count];
+		int ret = sendto(d->c->so.handle,(const char*)m->data,m->len,0,
+						m->addrlen > 0 ? (struct sockaddr*)&m->addr : NULL,m->addrlen);
+		if(ret < 0)
+		{
+			if(count == 0 && _ERRNO != _ERROR(EWOULDBLOCK)) return -1;
+			break;
+		}
+	}
+	return count;
+#endif
+}
+
+int datagram_flush(connection_datagram_t * d)
+{
+	connection_t * c = d->c;
+	while(d->wcount > 0)
+	{
+		int n = datagram_sendv(d,d->wcount);
+		if(n == 0)
+		{
+			//发送缓冲区满,等可写事件;批次满时暂停读
+			connection_cycle_mod(c,NGX_READ_EVENT | NGX_WRITE_EVENT);
+			break;
+		}
+		if(n < 0)
+		{
+			//只影响第一个,丢掉继续发后面的
+			int error = _ERRNO;
+			datagram_msg_t * m = &d->wmsgs[0];
+			LOGD("datagram send errno:%d len:%u segment:%u\n",error,m->len,m->segment);
+			if(m->segment > 0 && (error == EIO || error == EINVAL))
+			{
+				//网卡或路径不支持分段卸载,之后改为逐个发送
+				d->gso = 0;
+			}
+			d->dropped += datagram_segments(m);
+			n = 1;
+		}else{
+			for(int i = 0;i < n;i++)
+			{
+				d->tx += datagram_segments(&d->wmsgs[i]);
+			}
+		}
+		//没发出的换到前面,缓冲区跟着datagram_msg_t走
+		int remain = d->wcount - n;
+		for(int i = 0;i < remain;i++)
+		{
+			datagram_msg_t tmp = d->wmsgs[i];
+			d->wmsgs[i] = d->wmsgs[n + i];
+			d->wmsgs[n + i] = tmp;
+		}
+		d->wcount = remain;
+	}
+	if(d->wcount == 0 && (c->event & NGX_WRITE_EVENT))
+	{
+		connection_cycle_mod(c,NGX_READ_EVENT);
+	}
+	connection_watermark(c,d->wcount);
+	return d->wcount;
+}
+
+int datagram_send(connection_datagram_t * d,const struct sockaddr * addr,socklen_t addrlen,const void * buf,size_t len,uint32_t segment)
+{
+	if(segment >= len)
+	{
+		segment = 0;
+	}
+	if(segment > 0 && !d->gso)
+	{
+		//不能分段卸载时拆成单个数据报
+		int ret = 0;
+		const uint8_t * p = (const uint8_t*)buf;
+		while(len > 0)
+		{
+			size_t n = len < segment ? len : segment;
+			if(datagram_send(d,addr,addrlen,p,n,0) != 0) ret = -1;
+			p += n;
+			len -= n;
+		}
+		return ret;
+	}
+	uint32_t count = segment > 0 ? (uint32_t)((len + segment - 1) / segment) : 1;
+	if(len > d->size || addrlen > sizeof(struct sockaddr_storage))
+	{
+		d->dropped += count;
+		return -1;
+	}
+	if(d->wcount == d->batch && datagram_flush(d) == d->batch)
+	{
+		d->dropped += count;
+		return -1;
+	}
+	datagram_msg_t * m = &d->wmsgs[d->wcount++];
+	if(addr != NULL && addrlen > 0)
+	{
+		memcpy(&m->addr,addr,addrlen);
+		m->addrlen = addrlen;
+	}else{
+		m->addrlen = 0;
+	}
+	memcpy(m->data,buf,len);
+	m->len = (uint32_t)len;
+	m->segment = segment;
+	return 0;
+}
+
+static void datagram_read_handler(event_t * ev)
+{
+	connection_datagram_t * d = (connection_datagram_t*)ev->data;
+	connection_t * c = d->c;
+	event_del(c->cycle,c->so.read);
+	//水平触发注册,收不完的下一轮还会通知
+	for(int round = 0;round < DATAGRAM_ROUNDS;round++)
+	{
+		int n = datagram_recv(d);
+		if(n < 0)
+		{
+			//connect过的socket会收到对端不可达之类的错误,不影响后面的数据
+			LOGD("datagram recv errno:%d\n",_ERRNO);
+			break;
+		}
+		if(n == 0)
+		{
+			ev->ready = 0;
+			break;
+		}
+		d->handler(d,d->rmsgs,n);
+		if(c->read_paused)
+		{
+			break;
+		}
+	}
+	datagram_flush(d);
+}
+
+static void datagram_write_handler(event_t * ev)
+{
+	connection_datagram_t * d = (connection_datagram_t*)ev->data;
+	event_del(d->c->cycle,d->c->so.write);
+	datagram_flush(d);
+}
+
+//UDP的错误只是某次收发失败,取走后端点继续使用
+static void datagram_error_handler(event_t * ev)
+{
+	connection_datagram_t * d = (connection_datagram_t*)ev->data;
+	int error = 0;
+	socklen_t len = sizeof(error);
+	if(getsockopt(d->c->so.handle,SOL_SOCKET,SO_ERROR,(char*)&error,&len) != 0)
+	{
+		LOGE("datagram getsockopt errno:%d\n",_ERRNO);
+		connection_del(d->c);
+		return;
+	}
+	if(error != 0)
+	{
+		LOGD("datagram socket error:%d\n",error);
+	}
+}
+
+connection_datagram_t * datagram_create(cycle_t * cycle,SOCKET s,datagram_handler_pt handler,void * data)
+{
+	connection_t * c = connection_create(cycle,s);
+	ngx_pool_t * pool = connection_pool(c);
+	connection_datagram_t * d = NULL;
+	ngx_pool_cleanup_t * cln = NULL;
+	if(pool != NULL)
+	{
+		d = (connection_datagram_t*)ngx_pcalloc(pool,sizeof(connection_datagram_t));
+		cln = ngx_pool_cleanup_add(pool,sizeof(datagram_buffer_t));
+	}
+	if(d == NULL || cln == NULL)
+	{
+		LOGE("datagram create failed:%d\n",s);
+		close(s);
+		connection_destroy(&c);
+		return NULL;
+	}
+	d->c = c;
+	d->handler = handler;
+	d->data = data;
+	d->batch = DATAGRAM_BATCH;
+	d->size = DATAGRAM_SIZE;
+#if (NGX_HAVE_UDP_GRO)
+	int on = 1;
+	if(setsockopt(s,SOL_UDP,UDP_GRO,&on,sizeof(on)) == 0)
+	{
+		d->gro = 1;
+		d->batch = DATAGRAM_GRO_BATCH;
+		d->size = DATAGRAM_GRO_SIZE;
+	}
+#endif
+#if (NGX_HAVE_UDP_GSO)
+	d->gso = 1;
+#endif
+	datagram_buffer_t * b = (datagram_buffer_t*)cln->data;
+	b->data = MALLOC_TAG(MEM_TAG_BUFFER,(size_t)d->size * d->batch * 2);
+	cln->handler = datagram_cleanup;
+	d->rmsgs = (datagram_msg_t*)ngx_pcalloc(pool,sizeof(datagram_msg_t) * d->batch * 2);
+#if (NGX_HAVE_MMSG)
+	d->hdr = (struct mmsghdr*)ngx_pcalloc(pool,sizeof(struct mmsghdr) * d->batch);
+	d->iov = (struct iovec*)ngx_pcalloc(pool,sizeof(struct iovec) * d->batch);
+	d->control = (char*)ngx_pcalloc(pool,DATAGRAM_CONTROL * d->batch);
+	if(d->hdr == NULL || d->iov == NULL || d->control == NULL) d->rmsgs = NULL;
+#endif
+	if(b->data == NULL || d->rmsgs == NULL)
+	{
+		LOGE("datagram memory not enough:%d\n",s);
+		close(s);
+		connection_destroy(&c);
+		return NULL;
+	}
+	d->wmsgs = d->rmsgs + d->batch;
+	for(int i = 0;i < d->batch * 2;i++)
+	{
+		d->rmsgs[i].data = (uint8_t*)b->data + (size_t)i * d->size;
+	}
+	event_init(c->so.read,datagram_read_handler,d);
+	event_init(c->so.write,datagram_write_handler,d);
+	event_init(c->so.error,datagram_error_handler,d);
+	if(connection_cycle_add(c) != 0)
+	{
+		LOGE("datagram action_add errno:%d\n",_ERRNO);
+		close(s);
+		connection_destroy(&c);
+		return NULL;
+	}
+	//发送批次满时暂停接收,发出一半后恢复
+	connection_watermark_set(c,d->batch,d->batch / 2);
+	return d;
+}
@@ -0,0 +1,70 @@
+#ifndef DATAGRAM_H
+#define DATAGRAM_H
+
+#include "connection.h"
+
+//UDP端点:一个socket上的数据报成批收发,不区分对端,事件和生命周期沿用connection_t
+//Linux上用recvmmsg/sendmmsg一次系统调用收发一批,支持时打开UDP_GRO接收合并,发送时用UDP_SEGMENT分段
+//其他平台退回recvfrom/sendto逐个收发
+
+#if defined(__linux__)
+#define NGX_HAVE_MMSG 1
+#include <netinet/udp.h>
+#if defined(UDP_SEGMENT)
+#define NGX_HAVE_UDP_GSO 1
+#endif
+#if defined(UDP_GRO)
+#define NGX_HAVE_UDP_GRO 1
+#endif
+#endif
+
+#define DATAGRAM_BATCH 64			//一次系统调用最多收发的数据报数
+#define DATAGRAM_SIZE 2048			//每个数据报的缓冲区,更长的被截断后丢弃
+#define DATAGRAM_GRO_BATCH 16		//GRO打开时每个缓冲区可能装几十个数据报,批次小一些
+#define DATAGRAM_GRO_SIZE 65536
+#define DATAGRAM_ROUNDS 8			//一次可读事件最多收几批,剩下的等下一轮
+
+typedef struct datagram_msg_s{
+	struct sockaddr_storage addr;
+	socklen_t addrlen;				//0表示用connect的对端
+	uint8_t * data;
+	uint32_t len;
+	uint32_t segment;				//大于0时data是按segment长度连在一起的多个数据报,最后一个可以短一些
+}datagram_msg_t;
+
+struct connection_datagram_s;
+//msgs和其中的data只在调用期间有效
+typedef void (*datagram_handler_pt)(struct connection_datagram_s * d,datagram_msg_t * msgs,int count);
+
+typedef struct connection_datagram_s{
+	connection_t * c;
+	datagram_handler_pt handler;
+	void * data;
+	unsigned gro:1;
+	unsigned gso:1;
+	int batch;
+	uint32_t size;					//每个收发缓冲区的大小
+	datagram_msg_t * rmsgs;
+	datagram_msg_t * wmsgs;			//前wcount个待发送,每个指向自己的缓冲区
+	int wcount;
+#if (NGX_HAVE_MMSG)
+	struct mmsghdr * hdr;
+	struct iovec * iov;
+	char * control;
+#endif
+	uint64_t rx;					//收发的数据报数,合并的按分段计
+	uint64_t tx;
+	uint64_t dropped;				//截断、发送批次满或发送失败丢掉的
+}connection_datagram_t;
+
+//s为已经bind或connect的UDP socket,加入c->cycle后开始接收,失败时关闭s返回NULL
+connection_datagram_t * datagram_create(cycle_t * cycle,SOCKET s,datagram_handler_pt handler,void * data);
+//复制到发送批次,批次满时先发出;addr为NULL时发给connect的对端;发不出去时丢弃并返回-1
+//读事件处理完后自动发出,其他时候调用后要datagram_flush
+int datagram_send(connection_datagram_t * d,const struct sockaddr * addr,socklen_t addrlen,const void * buf,size_t len,uint32_t segment);
+//返回还没发出的数据报数,发送缓冲区满时等待可写事件
+int datagram_flush(connection_datagram_t * d);
+
+#define datagram_segments(m) ((m)->segment > 0 ? ((m)->len + (m)->segment - 1) / (m)->segment : 1)
+
+#endif
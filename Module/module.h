@@ -22,14 +22,105 @@
 
 inline int connection_cycle_add_(connection_t *conn,int event,int flags)
 {
+#ifdef NGX_FLAGS_ET
+	if(!(action_features(conn->cycle->core) & ACTION_FEATURE_ET))
+	{
+		flags &= ~NGX_FLAGS_ET;
+	}
+#endif
 	int ret =  action_add(conn->cycle->core,&conn->so,event,flags);
 	if(ret == 0)
 	{
+		conn->event = event;
+		conn->flags = flags;
 		connection_cycle_queue_add(conn);
 	}
 	return ret;
 }
 
+//按给定的事件精确设置,不做边缘触发的合并
+static inline int connection_cycle_set(connection_t *conn,int event)
+{
+	if(conn->event == event)
+	{
+		return 0;
+	}
+	int ret = action_mod(conn->cycle->core,&conn->so,event,conn->flags);
+	if(ret == 0)
+	{
+		conn->event = event;
+	}else{
+		LOGE("action_mod %d errno:%d\n",ret,_ERRNO);
+	}
+	return ret;
+}
+
+//修改关注的事件,没有变化时不调用事件模块
+//边缘触发时只增加不减少,多余的写事件通知不会重复触发
+//读暂停期间不关注读事件
+static inline int connection_cycle_mod(connection_t *conn,int event)
+{
+#ifdef NGX_FLAGS_ET
+	if(conn->flags & NGX_FLAGS_ET)
+	{
+		event |= conn->event;
+	}
+#endif
+	if(conn->read_paused)
+	{
+		event &= ~NGX_READ_EVENT;
+	}
+	return connection_cycle_set(conn,event);
+}
+
+//设置输出积压的高低水位,high为0时不限制
+static inline void connection_watermark_set(connection_t *conn,uint32_t high,uint32_t low)
+{
+	ASSERT(low <= high);
+	conn->high_water = high;
+	conn->low_water = low;
+}
+
+//暂停读:从事件模块去掉读事件,水平触发时不会再因为读就绪反复唤醒
+static inline void connection_read_pause(connection_t *conn)
+{
+	if(conn->read_paused)
+	{
+		return;
+	}
+	conn->read_paused = 1;
+	connection_cycle_set(conn,conn->event & ~NGX_READ_EVENT);
+	ngx_delete_posted_event(conn->so.read);
+}
+
+static inline void connection_read_resume(connection_t *conn)
+{
+	if(!conn->read_paused)
+	{
+		return;
+	}
+	conn->read_paused = 0;
+	connection_cycle_set(conn,conn->event | NGX_READ_EVENT);
+}
+
+//服务在积压变化后调用:达到高水位时从事件模块去掉读事件,
+//慢的对端不再让cycle反复唤醒、也不再继续占用内存;降到低水位以下时恢复
+//返回是否处于暂停状态,暂停期间服务不应再投递读事件
+static inline int connection_watermark(connection_t *conn,uint32_t pending)
+{
+	if(!conn->read_paused)
+	{
+		if(conn->high_water > 0 && pending >= conn->high_water)
+		{
+			connection_read_pause(conn);
+		}
+	}else if(pending <= conn->low_water)
+	{
+		connection_read_resume(conn);
+	}
+	return conn->read_paused;
+}
+
 inline int connection_cycle_add(connection_t *conn)
 {
 	return connection_cycle_add_(conn,NGX_READ_EVENT,0);
@@ -52,61 +143,71 @@ inline int connection_cycle_del(connection_t *conn)
 							event_del(conn->cycle,conn->so.write); \
 							event_del(conn->cycle,conn->so.error);}
 
-#define timer_add(cycle,ev,time) {ASSERT(ev!=NULL);ngx_event_add_timer(&cycle->timeout,ev,time);}
-#define timer_del(cycle,ev) if(ev != NULL){ngx_event_del_timer(&cycle->timeout,ev);}
+//默认放时间轮,timer_add_precise 放红黑树
+#define timer_add(cycle,ev,time) {ASSERT(ev!=NULL); \
+							if((ev)->timer_set && !(ev)->timer_wheel) ngx_event_del_timer(&cycle->timeout,ev); \
+							ngx_event_wheel_add(&cycle->wheel,ev,time);}
+#define timer_add_precise(cycle,ev,time) {ASSERT(ev!=NULL); \
+							if((ev)->timer_wheel) ngx_event_wheel_del(&cycle->wheel,ev); \
+							ngx_event_add_timer(&cycle->timeout,ev,time);}
+#define timer_del(cycle,ev) if(ev != NULL){ \
+							if((ev)->timer_wheel) ngx_event_wheel_del(&cycle->wheel,ev); \
+							else ngx_event_del_timer(&cycle->timeout,ev);}
 #define connection_timer_del(conn) {timer_del(conn->cycle,conn->so.read); \
 							timer_del(conn->cycle,conn->so.write); \
 							timer_del(conn->cycle,conn->so.error);}
 
 
 
-#define timer_is_empty(cycle) (cycle->timeout.root == cycle->timeout.sentinel)
-#define event_is_empty(cycle) ngx_queue_empty(&cycle->posted)
+#define timer_is_empty(cycle) (cycle->timeout.root == cycle->timeout.sentinel && ngx_event_wheel_empty(&cycle->wheel))
 
-//slave safe
-
-typedef void (*safe_event_handle_pt)(cycle_t * cycle,event_t *ev);
-
-typedef struct safe_event_s{
-	event_t self;
-	cycle_t *cycle;
-	event_t *event;
-	safe_event_handle_pt handler;
-}safe_event_t;
+static inline ngx_msec_t timer_find(cycle_t *cycle)
+{
+	ngx_msec_t timer = ngx_event_find_timer(&cycle->timeout);
+	ngx_msec_t wheel = ngx_event_wheel_find(&cycle->wheel);
+	//NGX_TIMER_INFINITE 是最大值
+	return timer < wheel ? timer : wheel;
+}
 
-static inline void safe_event_handler(event_t *ev)
+static inline void timer_expire(cycle_t *cycle)
 {
-	safe_event_t * sev = (safe_event_t*)ev->data;
-	sev->handler(sev->cycle,sev->event);
-	FREE(sev);
+	ngx_event_expire_timers(&cycle->timeout);
+	ngx_event_wheel_expire(&cycle->wheel);
 }
+#define event_is_empty(cycle) ngx_queue_empty(&cycle->posted)
+
+//slave safe
 
-static inline void safe_add_event(cycle_t *cycle,event_t * ev,safe_event_handle_pt handler)
+//任意线程调用,sev在处理完之前不能释放或再次投递
+static inline void safe_add_event(cycle_t *cycle,safe_event_t *sev)
 {
-	safe_event_t * sev = (safe_event_t*)MALLOC(sizeof(safe_event_t));
-	sev->cycle = cycle;
-	sev->event = ev;
-	sev->handler = handler;
-	event_init(&sev->self,safe_event_handler,sev);
-	ngx_spinlock(&cycle->async_posted_lock,1,0);
-	ngx_post_event(&sev->self,&cycle->async_posted);
-	cycle->async_posted_count += 1;
-	ngx_unlock(&cycle->async_posted_lock);
+	ASSERT(sev != NULL && sev->handler != NULL);
+	ngx_atomic_fetch_add(&cycle->load.backlog,1);
+	//只有取空之后的第一条消息需要唤醒
+	if(mpsc_queue_push(&cycle->async_posted,&sev->node))
+	{
+		cycle_wakeup(cycle);
+	}
 }
 
+//cycle自己的线程调用,一次取走全部消息按投递顺序处理
 static inline void safe_process_event(cycle_t *cycle)
 {
-	if(cycle->async_posted_count > 0)
+	mpsc_node_t * node = mpsc_queue_take(&cycle->async_posted);
+	ngx_atomic_int_t count = 0;
+	while(node != NULL)
 	{
-		ngx_spinlock(&cycle->async_posted_lock,1,0);
-		// if(ngx_trylock(&cycle->accept_lock))
-		{
-			ngx_queue_add(&cycle->posted,&cycle->async_posted);
-			ngx_queue_init(&cycle->async_posted);
-
-			cycle->async_posted_count = 0;
-			ngx_unlock(&cycle->async_posted_lock);
-		}
+		safe_event_t * sev = ngx_queue_data(node,safe_event_t,node);
+		//处理函数可能释放sev
+		node = node->next;
+		sev->handler(cycle,sev);
+		count++;
+	}
+	if(count > 0)
+	{
+		//先发布连接数再减积压,分发时不会低估负载
+		cycle->load.connections = cycle->connection_count;
+		ngx_atomic_fetch_add(&cycle->load.backlog,-count);
 	}
 }
 
@@ -189,6 +290,7 @@ static inline void connection_remove(connection_t * c)
 {
 	ASSERT(c != NULL);
 	ASSERT(c->so.error != NULL);
+	c->closing = 1;
 	// event_add(c->cycle,c->so.error);
 	if(!event_is_add(c->sycle,c->so.error)){
 		ngx_post_event(c->so.error,&c->cycle->internal_posted);
@@ -226,16 +328,20 @@ static inline int cycle_process(cycle_t * cycle)
 			ngx_time_update();
 		}
 		
-		ngx_msec_t timeout = ngx_event_find_timer(&cycle->timeout);
-		if(!event_is_empty(cycle))
+		cycle_stat_begin(&cycle->stat);
+		ngx_msec_t timeout = timer_find(cycle);
+		//internal_posted里有待关闭的连接、flush_posted里有step阶段之后才写入的输出时也不能阻塞
+		if(!event_is_empty(cycle) || !ngx_queue_empty(&cycle->internal_posted)
+			|| !ngx_queue_empty(&cycle->flush_posted))
 		{
 			timeout = 0;
 		}else
 		if(timeout == NGX_TIMER_INFINITE)
 		{
-			timeout = 10;
+			timeout = cycle_has_doorbell(cycle) ? CYCLE_IDLE_TIMEOUT : 10;
 		}
-		if(cycle->connection_count > 0)
+		//有门铃时空闲也阻塞在事件模块里,等待投递唤醒
+		if(cycle->connection_count > 0 || cycle_has_doorbell(cycle))
 		{
 			int ret = action_process(cycle->core,timeout);
 			if(ret == -1)
@@ -245,19 +351,30 @@ static inline int cycle_process(cycle_t * cycle)
 			{
 				// LOGD("action_process :%d\n",ret);
 			}
+			cycle_stat_events(&cycle->stat,ret);
 		}
 		
 		if(cycle->master)
 		{
 			ngx_time_update();
 		}
-		ngx_event_expire_timers(&cycle->timeout);
+		cycle_stat_phase(&cycle->stat,CYCLE_PHASE_ACTION);
+		timer_expire(cycle);
+		cycle_stat_phase(&cycle->stat,CYCLE_PHASE_TIMER);
 		safe_process_event(cycle);
+		cycle_stat_phase(&cycle->stat,CYCLE_PHASE_SAFE);
 		ngx_event_process_posted(&cycle->posted);
+		cycle_stat_phase(&cycle->stat,CYCLE_PHASE_POSTED);
 
 		ngx_event_process_posted(&cycle->internal_posted);
+		cycle_stat_phase(&cycle->stat,CYCLE_PHASE_INTERNAL);
 
+		//这一轮各处理函数合并的输出,每个连接一次writev
+		ngx_event_process_posted(&cycle->flush_posted);
 		cycle_process_step(cycle);
+		cycle_stat_phase(&cycle->stat,CYCLE_PHASE_STEP);
+		cycle_stat_end(&cycle->stat,timeout);
+		cycle_load_update(cycle);
 
 		if(cycle->master && 
 			cycle->connection_count == 0 && 
@@ -0,0 +1,242 @@
+#include "ngx_event_wheel.h"
+
+#ifndef ngx_abs
+#include <stdlib.h>
+#define ngx_abs abs
+#endif
+
+#define NGX_WHEEL_MAX_DELTA ((ngx_msec_int_t)1 << (NGX_WHEEL_LEVEL0_BITS + NGX_WHEEL_LEVELN_BITS * (NGX_WHEEL_LEVELS - 1)))
+
+#define ngx_wheel_shift(level) (NGX_WHEEL_LEVEL0_BITS + NGX_WHEEL_LEVELN_BITS * ((level) - 1))
+
+static int ngx_wheel_ctz(uint64_t x)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index,x);
+	return (int)index;
+#else
+	return __builtin_ctzll(x);
+#endif
+}
+
+static void ngx_wheel_insert(ngx_event_wheel_t * wheel,event_t *ev)
+{
+	ngx_msec_t key = ev->wheel.key;
+	ngx_msec_int_t delta = (ngx_msec_int_t)(key - wheel->current);
+	ngx_queue_t *slot;
+	ngx_uint_t index;
+	int level;
+
+	if(delta < NGX_WHEEL_LEVEL0_SIZE)
+	{
+		//已经过期的放到下一个要处理的槽
+		ngx_msec_t t = delta < 0 ? wheel->current : key;
+		index = t & NGX_WHEEL_LEVEL0_MASK;
+		slot = &wheel->level0[index];
+		wheel->bitmap[index >> 6] |= (uint64_t)1 << (index & 63);
+		level = 0;
+	}else{
+		if(delta >= NGX_WHEEL_MAX_DELTA)
+		{
+			key = wheel->current + NGX_WHEEL_MAX_DELTA - 1;
+			delta = NGX_WHEEL_MAX_DELTA - 1;
+		}
+		for(level = 1;level < NGX_WHEEL_LEVELS - 1;level++)
+		{
+			if(delta < ((ngx_msec_int_t)1 << ngx_wheel_shift(level + 1)))
+			{
+				break;
+			}
+		}
+		index = (key >> ngx_wheel_shift(level)) & NGX_WHEEL_LEVELN_MASK;
+		slot = &wheel->leveln[level - 1][index];
+	}
+	ngx_queue_insert_tail(slot,&ev->wheel.queue);
+	wheel->level_count[level]++;
+	ev->wheel.slot = (uint16_t)index;
+	ev->wheel.level = (uint8_t)level;
+}
+
+static void ngx_wheel_remove(ngx_event_wheel_t * wheel,event_t *ev)
+{
+	ngx_queue_remove(&ev->wheel.queue);
+	wheel->level_count[ev->wheel.level]--;
+	ngx_uint_t index = ev->wheel.slot;
+	if(ev->wheel.level == 0 && ngx_queue_empty(&wheel->level0[index]))
+	{
+		//第0层槽空了,清位图
+		wheel->bitmap[index >> 6] &= ~((uint64_t)1 << (index & 63));
+	}
+}
+
+void ngx_event_wheel_init(ngx_event_wheel_t * wheel)
+{
+	wheel->current = ngx_current_msec;
+	wheel->count = 0;
+	for(int i = 0;i < NGX_WHEEL_LEVELS;i++)
+	{
+		wheel->level_count[i] = 0;
+	}
+	for(int i = 0;i < NGX_WHEEL_LEVEL0_SIZE / 64;i++)
+	{
+		wheel->bitmap[i] = 0;
+	}
+	for(int i = 0;i < NGX_WHEEL_LEVEL0_SIZE;i++)
+	{
+		ngx_queue_init(&wheel->level0[i]);
+	}
+	for(int l = 0;l < NGX_WHEEL_LEVELS - 1;l++)
+	{
+		for(int i = 0;i < NGX_WHEEL_LEVELN_SIZE;i++)
+		{
+			ngx_queue_init(&wheel->leveln[l][i]);
+		}
+	}
+}
+
+void ngx_event_wheel_del(ngx_event_wheel_t * wheel,event_t *ev)
+{
+	if(ev->timer_set == 0 || ev->timer_wheel == 0)
+	{
+		return;
+	}
+	ngx_wheel_remove(wheel,ev);
+	wheel->count--;
+	ev->timer_set = 0;
+	ev->timer_wheel = 0;
+}
+
+void ngx_event_wheel_add(ngx_event_wheel_t * wheel,event_t *ev, ngx_msec_t timer)
+{
+	ngx_msec_t key = ngx_current_msec + timer;
+
+	if(ev->timer_set)
+	{
+		//与红黑树一样,相差不大时沿用原来的到期时间
+		ngx_msec_int_t diff = (ngx_msec_int_t)(key - ev->timer.key);
+		if(ev->timer_wheel && ngx_abs(diff) < NGX_TIMER_LAZY_DELAY)
+		{
+			return;
+		}
+		ASSERT(ev->timer_wheel);
+		ngx_event_wheel_del(wheel,ev);
+	}
+	if(wheel->count == 0)
+	{
+		//空闲时直接跳到当前时间,不必逐毫秒追赶
+		wheel->current = ngx_current_msec;
+	}
+	ev->wheel.key = key;
+	ngx_wheel_insert(wheel,ev);
+	wheel->count++;
+	ev->timer_set = 1;
+	ev->timer_wheel = 1;
+}
+
+ngx_msec_t ngx_event_wheel_find(ngx_event_wheel_t * wheel)
+{
+	if(wheel->count == 0)
+	{
+		return NGX_TIMER_INFINITE;
+	}
+	ngx_uint_t pos = wheel->current & NGX_WHEEL_LEVEL0_MASK;
+	ngx_msec_int_t distance = -1;
+	if(wheel->level_count[0] > 0)
+	{
+		//先找本轮剩下的槽,再找回绕之后的槽
+		for(ngx_uint_t i = pos >> 6;i < NGX_WHEEL_LEVEL0_SIZE / 64 && distance < 0;i++)
+		{
+			uint64_t bits = wheel->bitmap[i];
+			if(i == (pos >> 6)) bits &= ~(uint64_t)0 << (pos & 63);
+			if(bits != 0) distance = (ngx_msec_int_t)(i * 64 + ngx_wheel_ctz(bits) - pos);
+		}
+		for(ngx_uint_t i = 0;i <= (pos >> 6) && distance < 0;i++)
+		{
+			uint64_t bits = wheel->bitmap[i];
+			if(i == (pos >> 6)) bits &= ((uint64_t)1 << (pos & 63)) - 1;
+			if(bits != 0) distance = (ngx_msec_int_t)(NGX_WHEEL_LEVEL0_SIZE + i * 64 + ngx_wheel_ctz(bits) - pos);
+		}
+	}
+	if(wheel->count > wheel->level_count[0])
+	{
+		//高层的定时器在第0层回绕时下移
+		ngx_msec_int_t cascade = (ngx_msec_int_t)(NGX_WHEEL_LEVEL0_SIZE - pos);
+		if(pos == 0) cascade = 0;
+		if(distance < 0 || cascade < distance) distance = cascade;
+	}
+	ngx_msec_int_t timer = (ngx_msec_int_t)(wheel->current + distance - ngx_current_msec);
+	return (ngx_msec_t)(timer > 0 ? timer : 0);
+}
+
+//把高层一个槽的定时器重新放到低层
+static void ngx_wheel_cascade(ngx_event_wheel_t * wheel,int level)
+{
+	ngx_queue_t *slot = &wheel->leveln[level - 1][(wheel->current >> ngx_wheel_shift(level)) & NGX_WHEEL_LEVELN_MASK];
+	ngx_queue_t tmp;
+	ngx_queue_init(&tmp);
+	ngx_queue_add(&tmp,slot);
+	ngx_queue_init(slot);
+	while(!ngx_queue_empty(&tmp))
+	{
+		ngx_queue_t *q = ngx_queue_head(&tmp);
+		event_t *ev = ngx_queue_data(q,event_t,wheel.queue);
+		ngx_queue_remove(q);
+		wheel->level_count[level]--;
+		ngx_wheel_insert(wheel,ev);
+	}
+}
+
+void ngx_event_wheel_expire(ngx_event_wheel_t * wheel)
+{
+	while(wheel->count > 0 && (ngx_msec_int_t)(ngx_current_msec - wheel->current) >= 0)
+	{
+		ngx_uint_t index = wheel->current & NGX_WHEEL_LEVEL0_MASK;
+		if(index == 0)
+		{
+			for(int level = 1;level < NGX_WHEEL_LEVELS;level++)
+			{
+				ngx_wheel_cascade(wheel,level);
+				if(((wheel->current >> ngx_wheel_shift(level)) & NGX_WHEEL_LEVELN_MASK) != 0)
+				{
+					break;
+				}
+			}
+		}
+		else if(wheel->level_count[0] == 0)
+		{
+			//第0层为空,直接跳到下一次回绕
+			ngx_msec_int_t skip = (ngx_msec_int_t)(NGX_WHEEL_LEVEL0_SIZE - index);
+			ngx_msec_int_t behind = (ngx_msec_int_t)(ngx_current_msec - wheel->current) + 1;
+			wheel->current += skip < behind ? skip : behind;
+			continue;
+		}
+
+		ngx_queue_t *slot = &wheel->level0[index];
+		ngx_queue_t tmp;
+		ngx_queue_init(&tmp);
+		ngx_queue_add(&tmp,slot);
+		ngx_queue_init(slot);
+		wheel->bitmap[index >> 6] &= ~((uint64_t)1 << (index & 63));
+		//回调里新加的0延迟定时器落到下一个槽
+		wheel->current++;
+
+		while(!ngx_queue_empty(&tmp))
+		{
+			ngx_queue_t *q = ngx_queue_head(&tmp);
+			event_t *ev = ngx_queue_data(q,event_t,wheel.queue);
+			ngx_queue_remove(q);
+			ngx_queue_init(q);
+			wheel->level_count[0]--;
+			wheel->count--;
+			ev->timer_set = 0;
+			ev->timer_wheel = 0;
+			ev->timedout = 1;
+			ev->handler(ev);
+		}
+	}
+	if(wheel->count == 0)
+	{
+		wheel->current = ngx_current_msec;
+	}
+}
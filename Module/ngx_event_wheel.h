@@ -0,0 +1,38 @@
+#ifndef EVENTWHEEL_H
+#define EVENTWHEEL_H
+
+#include "ngx_times.h"
+#include "ngx_event_timer.h"
+
+//分层时间轮,精度1毫秒,增删和到期都是O(1)
+//第0层256个槽,每槽1毫秒;其余3层各64个槽,到期前逐层下移
+//超过最大范围(约18.6小时)的定时器放在最高层,下移时重新计算
+
+#define NGX_WHEEL_LEVEL0_BITS 8
+#define NGX_WHEEL_LEVELN_BITS 6
+#define NGX_WHEEL_LEVELS 4
+
+#define NGX_WHEEL_LEVEL0_SIZE (1 << NGX_WHEEL_LEVEL0_BITS)
+#define NGX_WHEEL_LEVELN_SIZE (1 << NGX_WHEEL_LEVELN_BITS)
+#define NGX_WHEEL_LEVEL0_MASK (NGX_WHEEL_LEVEL0_SIZE - 1)
+#define NGX_WHEEL_LEVELN_MASK (NGX_WHEEL_LEVELN_SIZE - 1)
+
+typedef struct ngx_event_wheel_s{
+	ngx_msec_t current;		//下一个要处理的毫秒
+	ngx_uint_t count;
+	ngx_uint_t level_count[NGX_WHEEL_LEVELS];
+	//第0层非空槽的位图,用来快速找到下一个到期时间
+	uint64_t bitmap[NGX_WHEEL_LEVEL0_SIZE / 64];
+	ngx_queue_t level0[NGX_WHEEL_LEVEL0_SIZE];
+	ngx_queue_t leveln[NGX_WHEEL_LEVELS - 1][NGX_WHEEL_LEVELN_SIZE];
+}ngx_event_wheel_t;
+
+#define ngx_event_wheel_empty(wheel) ((wheel)->count == 0)
+
+void ngx_event_wheel_init(ngx_event_wheel_t * wheel);
+void ngx_event_wheel_add(ngx_event_wheel_t * wheel,event_t *ev, ngx_msec_t timer);
+void ngx_event_wheel_del(ngx_event_wheel_t * wheel,event_t *ev);
+ngx_msec_t ngx_event_wheel_find(ngx_event_wheel_t * wheel);
+void ngx_event_wheel_expire(ngx_event_wheel_t * wheel);
+
+#endif
@@ -7,14 +7,21 @@
 #include "module.h"
 
 
-typedef struct cycle_slave_s{
+typedef struct cycle_slave_s cycle_slave_t;
+
+//返回下一个连接分给哪个cycle
+typedef int (*slave_dispatch_pt)(cycle_slave_t *slave);
+
+struct cycle_slave_s{
 	int concurrent;
 	int max_cycle_count;
 	int cycle_pool_index;
 	ngx_array_t *cycle_pool;
 	ngx_array_t *thread_pool;
 	cycle_ptr * ptr;
-}cycle_slave_t;
+	slave_dispatch_pt dispatch;
+	uint32_t random;
+};
 
 inline void *ngx_array_get(ngx_array_t *a, ngx_uint_t n)
 {
@@ -32,6 +39,8 @@ static inline cycle_slave_t *slave_create(int concurrent,int thread_count,cycle_
 	slave->cycle_pool = ngx_array_create(thread_count,sizeof(cycle_t*));
 	slave->thread_pool = ngx_array_create(thread_count,sizeof(uv_thread_t));
 	slave->ptr = ptr;
+	slave->dispatch = NULL;
+	slave->random = 2463534242u;
 	return slave;
 }
 
@@ -48,6 +57,7 @@ static inline void slave_destroy(cycle_slave_t**slave_ptr){
 			if((*cycle_ptr)->stop != 1)
 			{
 				(*cycle_ptr)->stop = 1;
+				cycle_wakeup(*cycle_ptr);
 
 				if(thread_id != NULL)
 				{
@@ -66,7 +76,7 @@ static inline void slave_destroy(cycle_slave_t**slave_ptr){
 	*slave_ptr = NULL;
 }
 
-inline void slave_stop(cycle_slave_t*slave)
+static inline void slave_stop(cycle_slave_t*slave)
 {
 	ASSERT(slave != NULL);
 	for(int i = 0 ; i < slave->max_cycle_count;i++)
@@ -78,12 +88,13 @@ inline void slave_stop(cycle_slave_t*slave)
 			if((*cycle_ptr)->stop != 1)
 			{
 				(*cycle_ptr)->stop = 1;
+				cycle_wakeup(*cycle_ptr);
 			}
 		}
 	}
 }
 
-inline void slave_wait_stop(cycle_slave_t*slave)
+static inline void slave_wait_stop(cycle_slave_t*slave)
 {
 	ASSERT(slave != NULL);
 	for(int i = 0 ; i < slave->max_cycle_count;i++)
@@ -96,6 +107,7 @@ inline void slave_wait_stop(cycle_slave_t*slave)
 			if((*cycle_ptr)->stop != 1)
 			{
 				(*cycle_ptr)->stop = 1;
+				cycle_wakeup(*cycle_ptr);
 				ASSERT(uv_thread_join(thread_id) == 0);
 			}
 		}
@@ -108,9 +120,9 @@ static inline void slave_thread_cb(void* arg)
 	cycle_process(cycle);
 }
 
-static inline cycle_t * slave_next_cycle(cycle_slave_t *slave)
+//取第index个cycle,还没创建时创建并启动线程
+static inline cycle_t * slave_cycle(cycle_slave_t *slave,int index)
 {
-	int index = slave->cycle_pool_index%slave->max_cycle_count;
 	cycle_t ** cycle_ptr = (cycle_t**)ngx_array_get(slave->cycle_pool,index);
 	ABORTI(cycle_ptr == NULL);
 	if(*cycle_ptr == NULL)
@@ -128,9 +140,163 @@ static inline cycle_t * slave_next_cycle(cycle_slave_t *slave)
 		ABORTI(ret != 0);
 	}
 	ABORTI(*cycle_ptr == NULL);
-	slave->cycle_pool_index++;
 	return *cycle_ptr;
 }
 
+//分发策略,只在主线程调用,负载信息由各cycle自己发布
+
+static inline int slave_dispatch_round_robin(cycle_slave_t *slave)
+{
+	int index = slave->cycle_pool_index%slave->max_cycle_count;
+	slave->cycle_pool_index++;
+	return index;
+}
+
+//还没启动的cycle负载为0
+static inline cycle_t * slave_peek_cycle(cycle_slave_t *slave,int index)
+{
+	cycle_t ** cycle_ptr = (cycle_t**)ngx_array_get(slave->cycle_pool,index);
+	return cycle_ptr != NULL ? *cycle_ptr : NULL;
+}
+
+static inline ngx_atomic_int_t slave_cycle_score(cycle_slave_t *slave,int index)
+{
+	cycle_t * cycle = slave_peek_cycle(slave,index);
+	return cycle != NULL ? cycle_load_score(cycle) : 0;
+}
+
+static inline int slave_dispatch_least_connections(cycle_slave_t *slave)
+{
+	//从轮询位置开始找,负载相同时不总是落在第一个
+	int start = slave_dispatch_round_robin(slave);
+	int best = start;
+	ngx_atomic_int_t best_score = slave_cycle_score(slave,start);
+	for(int i = 1;i < slave->max_cycle_count && best_score > 0;i++)
+	{
+		int index = (start + i)%slave->max_cycle_count;
+		ngx_atomic_int_t score = slave_cycle_score(slave,index);
+		if(score < best_score)
+		{
+			best = index;
+			best_score = score;
+		}
+	}
+	return best;
+}
+
+static inline uint32_t slave_random(cycle_slave_t *slave)
+{
+	uint32_t x = slave->random;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	slave->random = x;
+	return x;
+}
+
+//随机取两个,选负载低的
+static inline int slave_dispatch_two_choices(cycle_slave_t *slave)
+{
+	int a = slave_random(slave)%slave->max_cycle_count;
+	int b = slave_random(slave)%slave->max_cycle_count;
+	return slave_cycle_score(slave,b) < slave_cycle_score(slave,a) ? b : a;
+}
+
+//连接数按线程忙碌程度加权,忙的线程分到更少的连接
+static inline int slave_dispatch_busy(cycle_slave_t *slave)
+{
+	int start = slave_dispatch_round_robin(slave);
+	int best = start;
+	uint64_t best_score = 0;
+	for(int i = 0;i < slave->max_cycle_count;i++)
+	{
+		int index = (start + i)%slave->max_cycle_count;
+		cycle_t * cycle = slave_peek_cycle(slave,index);
+		if(cycle == NULL)
+		{
+			return index;
+		}
+		uint64_t score = (uint64_t)(cycle_load_score(cycle) + 1) * (cycle->load.busy + 1);
+		if(i == 0 || score < best_score)
+		{
+			best = index;
+			best_score = score;
+		}
+	}
+	return best;
+}
+
+typedef struct slave_dispatch_s{
+	const char * name;
+	slave_dispatch_pt dispatch;
+}slave_dispatch_t;
+
+static slave_dispatch_t g_slave_dispatch[] = {
+	{"rr",slave_dispatch_round_robin},
+	{"least",slave_dispatch_least_connections},
+	{"p2c",slave_dispatch_two_choices},
+	{"busy",slave_dispatch_busy},
+	{NULL,NULL}
+};
+
+//name为NULL时使用轮询
+static inline int slave_dispatch_select(cycle_slave_t *slave,const char * name)
+{
+	if(name == NULL)
+	{
+		slave->dispatch = slave_dispatch_round_robin;
+		return 0;
+	}
+	for(int i = 0;g_slave_dispatch[i].name != NULL;i++)
+	{
+		if(strcmp(g_slave_dispatch[i].name,name) == 0)
+		{
+			slave->dispatch = g_slave_dispatch[i].dispatch;
+			return 0;
+		}
+	}
+	LOGE("unknown dispatch:%s\n",name);
+	return -1;
+}
+
+static inline int slave_next_index(cycle_slave_t *slave)
+{
+	slave_dispatch_pt dispatch = slave->dispatch != NULL ? slave->dispatch : slave_dispatch_round_robin;
+	int index = dispatch(slave);
+	ASSERT(index >= 0 && index < slave->max_cycle_count);
+	return index;
+}
+
+static inline cycle_t * slave_next_cycle(cycle_slave_t *slave)
+{
+	return slave_cycle(slave,slave_next_index(slave));
+}
+
+//汇总全部已启动slave的统计快照,不停止线程,返回汇总的cycle数
+static inline int slave_stat_snapshot(cycle_slave_t *slave,cycle_stat_t *out)
+{
+	int count = 0;
+	cycle_stat_t stat;
+	for(int i = 0 ; i < slave->max_cycle_count;i++)
+	{
+		cycle_t * cycle = slave_peek_cycle(slave,i);
+		if(cycle != NULL && cycle_stat_snapshot(&cycle->stat,&stat) == 0)
+		{
+			cycle_stat_merge(out,&stat);
+			count++;
+		}
+	}
+	return count;
+}
+
+//一次启动全部线程,各线程自己监听时使用
+static inline void slave_start(cycle_slave_t *slave)
+{
+	for(int i = 0 ; i < slave->max_cycle_count;i++)
+	{
+		slave_cycle(slave,i);
+	}
+}
+
 
 #endif
@@ -0,0 +1,192 @@
+#include "module.h"
+#include "zerocopy.h"
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif
+
+static void zerocopy_release_fire(connection_zerocopy_t * zc,int all)
+{
+	while(zc->head != NULL)
+	{
+		zerocopy_release_t * r = zc->head;
+		//序号会回绕,用差值比较
+		if(!all && (int32_t)(zc->done - r->id) < 0)
+		{
+			break;
+		}
+		zc->head = r->next;
+		if(zc->head == NULL) zc->tail = NULL;
+		r->handler(r->data,r->buf,r->size);
+		r->next = zc->free;
+		zc->free = r;
+	}
+}
+
+//连接释放时归还全部缓冲区,socket已经关闭,不再等待完成通知
+static void zerocopy_cleanup(void * data)
+{
+	zerocopy_release_fire((connection_zerocopy_t*)data,1);
+}
+
+static connection_zerocopy_t * zerocopy_get(connection_t * c)
+{
+	if(c->zerocopy != NULL)
+	{
+		return c->zerocopy;
+	}
+	ngx_pool_t * pool = connection_pool(c);
+	if(pool == NULL)
+	{
+		return NULL;
+	}
+	ngx_pool_cleanup_t * cln = ngx_pool_cleanup_add(pool,0);
+	connection_zerocopy_t * zc = (connection_zerocopy_t*)ngx_pcalloc(pool,sizeof(connection_zerocopy_t));
+	if(cln == NULL || zc == NULL)
+	{
+		return NULL;
+	}
+	zc->c = c;
+	cln->handler = zerocopy_cleanup;
+	cln->data = zc;
+	c->zerocopy = zc;
+	return zc;
+}
+
+int connection_zerocopy_enable(connection_t * c)
+{
+	connection_zerocopy_t * zc = zerocopy_get(c);
+	if(zc == NULL)
+	{
+		return -1;
+	}
+#if (NGX_HAVE_ZEROCOPY)
+	int on = 1;
+	if(setsockopt(c->so.handle,SOL_SOCKET,SO_ZEROCOPY,&on,sizeof(on)) != 0)
+	{
+		LOGD("SO_ZEROCOPY errno:%d\n",_ERRNO);
+		return -1;
+	}
+	zc->enable = 1;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+int connection_send_zerocopy(connection_t * c,const void * buf,size_t size)
+{
+#if (NGX_HAVE_ZEROCOPY)
+	connection_zerocopy_t * zc = c->zerocopy;
+	if(zc != NULL && zc->enable && size >= ZEROCOPY_MIN_SIZE)
+	{
+		int ret = send(c->so.handle,buf,size,MSG_ZEROCOPY);
+		if(ret >= 0)
+		{
+			zc->sent++;
+			return ret;
+		}
+		//锁定页面失败等情况,退回普通发送
+		if(_ERRNO != ENOBUFS)
+		{
+			return ret;
+		}
+	}
+#endif
+	return send(c->so.handle,buf,size,0);
+}
+
+int connection_zerocopy_release(connection_t * c,zerocopy_release_pt handler,void * data,void * buf,size_t size)
+{
+	connection_zerocopy_t * zc = c->zerocopy;
+	if(zc == NULL || zc->done == zc->sent)
+	{
+		handler(data,buf,size);
+		return 0;
+	}
+	zerocopy_release_t * r = zc->free;
+	if(r != NULL)
+	{
+		zc->free = r->next;
+	}else{
+		r = (zerocopy_release_t*)ngx_palloc(connection_pool(c),sizeof(zerocopy_release_t));
+		if(r == NULL)
+		{
+			return -1;
+		}
+	}
+	r->next = NULL;
+	r->id = zc->sent;
+	r->handler = handler;
+	r->data = data;
+	r->buf = buf;
+	r->size = size;
+	if(zc->tail != NULL)
+	{
+		zc->tail->next = r;
+	}else{
+		zc->head = r;
+	}
+	zc->tail = r;
+	return 0;
+}
+
+int connection_zerocopy_complete(connection_t * c)
+{
+	int count = 0;
+#if (NGX_HAVE_ZEROCOPY)
+	connection_zerocopy_t * zc = c->zerocopy;
+	while(zc != NULL)
+	{
+		char control[128];
+		struct msghdr msg;
+		MEMZERO(&msg,sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if(recvmsg(c->so.handle,&msg,MSG_ERRQUEUE) == -1)
+		{
+			//EAGAIN表示队列已空
+			break;
+		}
+		struct cmsghdr * cm = CMSG_FIRSTHDR(&msg);
+		if(cm == NULL)
+		{
+			break;
+		}
+		struct sock_extended_err * ee = (struct sock_extended_err*)CMSG_DATA(cm);
+		if(ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY || ee->ee_errno != 0)
+		{
+			LOGE("errqueue origin:%d errno:%d\n",ee->ee_origin,ee->ee_errno);
+			return -1;
+		}
+		//[ee_info,ee_data] 这一段发送已完成
+		uint32_t hi = ee->ee_data + 1;
+		count += hi - ee->ee_info;
+		if((int32_t)(hi - zc->done) > 0)
+		{
+			zc->done = hi;
+		}
+		if(ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+		{
+			//比如回环网卡,内核还是复制了,零拷贝只剩额外开销
+			if(zc->copied++ == 0)
+			{
+				LOGD("zerocopy copied by kernel:%d, fallback to send\n",c->so.handle);
+			}
+			zc->enable = 0;
+		}
+	}
+	if(zc != NULL)
+	{
+		zerocopy_release_fire(zc,0);
+	}
+#endif
+	int error = 0;
+	socklen_t len = sizeof(error);
+	if(getsockopt(c->so.handle,SOL_SOCKET,SO_ERROR,(char*)&error,&len) != 0 || error != 0)
+	{
+		return -1;
+	}
+	return count;
+}
@@ -0,0 +1,51 @@
+#ifndef ZEROCOPY_H
+#define ZEROCOPY_H
+
+#include "connection.h"
+
+//MSG_ZEROCOPY发送:内核直接引用用户内存,发送完成后在socket的错误队列里通知
+//通知到达之前缓冲区不能修改或归还,connection_zerocopy_release 登记的释放回调在之前的发送全部完成后才调用
+//TCP按发送顺序完成,只记录连续完成到的序号
+
+#if defined(__linux__)
+#include <linux/errqueue.h>
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define NGX_HAVE_ZEROCOPY 1
+#endif
+#endif
+
+//小于这个长度时复制比页面锁定更便宜,直接send
+#define ZEROCOPY_MIN_SIZE (10*1024)
+
+typedef void (*zerocopy_release_pt)(void * data,void * buf,size_t size);
+
+typedef struct zerocopy_release_s{
+	struct zerocopy_release_s * next;
+	uint32_t id;				//完成数达到id后释放
+	zerocopy_release_pt handler;
+	void * data;
+	void * buf;
+	size_t size;
+}zerocopy_release_t;
+
+typedef struct connection_zerocopy_s{
+	connection_t * c;
+	unsigned enable:1;
+	uint32_t sent;				//带MSG_ZEROCOPY成功发送的次数,也是下一个发送的序号
+	uint32_t done;				//已完成的发送数
+	uint32_t copied;			//内核回退为复制的次数,出现后不再使用零拷贝
+	zerocopy_release_t * head;	//按id排序的待释放缓冲区
+	zerocopy_release_t * tail;
+	zerocopy_release_t * free;	//回收的节点,节点从连接内存池分配
+}connection_zerocopy_t;
+
+//打开SO_ZEROCOPY,不支持时返回-1,之后的发送都走普通send
+int connection_zerocopy_enable(connection_t * c);
+//返回值和send一样
+int connection_send_zerocopy(connection_t * c,const void * buf,size_t size);
+//buf在此之前的零拷贝发送全部完成后交给handler,没有未完成的发送时立即调用
+int connection_zerocopy_release(connection_t * c,zerocopy_release_pt handler,void * data,void * buf,size_t size);
+//错误事件里调用,取出错误队列中的完成通知,返回完成的发送数,socket有错误时返回-1
+int connection_zerocopy_complete(connection_t * c);
+
+#endif
@@ -0,0 +1,779 @@
+#include "Module/module.h"
+#include "Core/thread.h"
+#include "Function/loopqueue.h"
+#include "Function/mirrorqueue.h"
+#include "Function/frame.h"
+#include "Function/echo.h"
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+#define GET_PARAM(PARAM,I)	if(argc >= I+1) PARAM = argv[I];
+#define GET_PARAM_INT(PARAM,I)	if(argc >= I+1) PARAM = atoi(argv[I]);
+
+static int compare_uint64(const void *a,const void *b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static uint64_t percentile(uint64_t *samples,int count,int percent)
+{
+	if(count <= 0) return 0;
+	int index = (int)((int64_t)count * percent / 100);
+	if(index >= count) index = count - 1;
+	return samples[index];
+}
+
+//action: 同样的echo负载依次跑在每个事件模块上
+//服务端是真实的TCP echo服务(echo_init),客户端连接和它在同一个cycle里,每个连接同时只有一条消息在路上
+//系统调用数是测出来的:事件模块自己的等待和注册由 action_syscalls 计数,
+//收发数据的read/readv/write/writev取 /proc/self/io 的 syscr+syscw 差值
+
+typedef struct action_bench_s{
+	int messages;
+	int completed;
+	int total;
+	int connections;
+	struct action_peer_s * peers;
+	//init时记下起点,全部完成的那一轮在step里记下终点
+	uint64_t begin;
+	uint64_t used;
+	uint64_t action_syscalls;
+	uint64_t io_syscalls;
+	uint64_t events;
+	uint64_t *samples;
+	int samples_count;
+}action_bench_t;
+
+typedef struct action_peer_s{
+	connection_t * c;
+	action_bench_t * bench;
+	int sent;
+}action_peer_t;
+
+//本进程收发数据的系统调用数,不含send/recv/sendmsg,读不到时返回0
+static uint64_t action_bench_io_syscalls()
+{
+	uint64_t count = 0;
+#if defined(__linux__)
+	FILE * fp = fopen("/proc/self/io","r");
+	if(fp == NULL)
+	{
+		return 0;
+	}
+	char line[128];
+	unsigned long long value;
+	while(fgets(line,sizeof(line),fp) != NULL)
+	{
+		if(sscanf(line,"syscr: %llu",&value) == 1 || sscanf(line,"syscw: %llu",&value) == 1)
+		{
+			count += value;
+		}
+	}
+	fclose(fp);
+#endif
+	return count;
+}
+
+//到目前为止事件模块返回的事件数,本轮的在cycle_stat_end里才计入
+static uint64_t action_bench_events(cycle_t * cycle)
+{
+#if (NGX_CYCLE_STAT)
+	return cycle->stat.stat.events.sum + cycle->stat.events;
+#else
+	return 0;
+#endif
+}
+
+static void action_bench_send(action_peer_t * peer)
+{
+	uint64_t now = time_nanosecond();
+	if(write(peer->c->so.handle,&now,sizeof(now)) == sizeof(now))
+	{
+		peer->sent++;
+	}
+}
+
+static void action_bench_read(event_t *ev)
+{
+	action_peer_t * peer = (action_peer_t*)ev->data;
+	action_bench_t * bench = peer->bench;
+	uint64_t stamp;
+	while(read(peer->c->so.handle,&stamp,sizeof(stamp)) == sizeof(stamp))
+	{
+		if(bench->samples_count < bench->total)
+		{
+			bench->samples[bench->samples_count++] = time_nanosecond() - stamp;
+		}
+		bench->completed++;
+		if(peer->sent < bench->messages)
+		{
+			action_bench_send(peer);
+		}
+	}
+}
+
+static void action_bench_init(cycle_t * cycle)
+{
+	action_bench_t * bench = (action_bench_t*)cycle->data;
+	bench->events = action_bench_events(cycle);
+	bench->action_syscalls = action_syscalls(cycle->core);
+	bench->io_syscalls = action_bench_io_syscalls();
+	bench->begin = time_nanosecond();
+	for(int i = 0;i < bench->connections;i++)
+	{
+		action_bench_send(&bench->peers[i]);
+	}
+}
+
+static void action_bench_step(cycle_t * cycle)
+{
+	action_bench_t * bench = (action_bench_t*)cycle->data;
+	if(bench->completed < bench->total || cycle->stop)
+	{
+		return;
+	}
+	bench->used = time_nanosecond() - bench->begin;
+	bench->events = action_bench_events(cycle) - bench->events;
+	bench->action_syscalls = action_syscalls(cycle->core) - bench->action_syscalls;
+	bench->io_syscalls = action_bench_io_syscalls() - bench->io_syscalls;
+	cycle->stop = 1;
+}
+
+static cycle_ptr action_bench_ptr = {action_bench_init,action_bench_step,NULL,NULL,NULL};
+
+//本机回环上建立一对TCP连接,返回服务端一侧,客户端一侧通过client返回
+static SOCKET action_bench_pair(SOCKET listen_fd,struct sockaddr_in * addr,SOCKET * client)
+{
+	SOCKET fd = socket(AF_INET,SOCK_STREAM,0);
+	if(fd == -1)
+	{
+		return -1;
+	}
+	if(connect(fd,(struct sockaddr*)addr,sizeof(*addr)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	SOCKET server = accept(listen_fd,NULL,NULL);
+	if(server == -1)
+	{
+		close(fd);
+		return -1;
+	}
+	int one = 1;
+	setsockopt(fd,IPPROTO_TCP,TCP_NODELAY,(const char*)&one,sizeof(one));
+	setsockopt(server,IPPROTO_TCP,TCP_NODELAY,(const char*)&one,sizeof(one));
+	socket_nonblocking(fd);
+	socket_nonblocking(server);
+	*client = fd;
+	return server;
+}
+
+static int action_bench_run(const char * name,int connections,int messages)
+{
+	if(action_select(name) != 0)
+	{
+		return -1;
+	}
+	//选中的模块创建失败时cycle_create不会报错,先试一次
+	core_t * core = action_create(1);
+	if(core == NULL || strcmp(action_name(core),name) != 0)
+	{
+		LOGI("%-8s unavailable\n",name);
+		if(core != NULL) action_done(core);
+		return -1;
+	}
+	action_done(core);
+
+	SOCKET listen_fd = socket(AF_INET,SOCK_STREAM,0);
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	MEMZERO(&addr,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if(listen_fd == -1 || bind(listen_fd,(struct sockaddr*)&addr,sizeof(addr)) != 0
+		|| listen(listen_fd,connections) != 0
+		|| getsockname(listen_fd,(struct sockaddr*)&addr,&addr_len) != 0)
+	{
+		LOGE("%s listen errno:%d\n",name,_ERRNO);
+		if(listen_fd != -1) close(listen_fd);
+		return -1;
+	}
+
+	action_bench_t bench;
+	MEMZERO(&bench,sizeof(bench));
+	bench.messages = messages;
+	bench.samples = (uint64_t*)MALLOC(sizeof(uint64_t)*connections*messages);
+	bench.peers = (action_peer_t*)MALLOC(sizeof(action_peer_t)*connections);
+	//每对连接两端加上门铃
+	cycle_t * cycle = cycle_create(connections * 2 + 1,&action_bench_ptr);
+	cycle->data = &bench;
+
+	for(int i = 0;i < connections;i++)
+	{
+		SOCKET client;
+		SOCKET server = action_bench_pair(listen_fd,&addr,&client);
+		if(server == -1)
+		{
+			LOGE("%s connect errno:%d\n",name,_ERRNO);
+			break;
+		}
+		//服务端走和server一样的echo服务
+		connection_t * s = connection_create(cycle,server);
+		echo_init(s);
+#ifdef NGX_FLAGS_ET
+		int ret = connection_cycle_add_(s,NGX_READ_EVENT,NGX_FLAGS_ET);
+#else
+		int ret = connection_cycle_add(s);
+#endif
+		if(ret != 0)
+		{
+			LOGE("%s action_add errno:%d\n",name,_ERRNO);
+			connection_destroy_object(s);
+			close(client);
+			break;
+		}
+		action_peer_t * peer = &bench.peers[bench.connections];
+		peer->bench = &bench;
+		peer->sent = 0;
+		peer->c = connection_create(cycle,client);
+		event_init(peer->c->so.read,action_bench_read,peer);
+		event_init(peer->c->so.error,connection_error_handle,peer->c);
+		if(connection_cycle_add(peer->c) != 0)
+		{
+			//已注册的服务端连接在cycle_process结束时关闭
+			LOGE("%s action_add errno:%d\n",name,_ERRNO);
+			connection_destroy_object(peer->c);
+			break;
+		}
+		bench.connections++;
+	}
+	bench.total = bench.connections * messages;
+
+	//没有连接时第一轮就结束,退出前cycle_process关闭全部连接
+	cycle_process(cycle);
+
+	uint64_t syscalls = bench.action_syscalls + bench.io_syscalls;
+	qsort(bench.samples,bench.samples_count,sizeof(uint64_t),compare_uint64);
+	LOGI("%-8s msgs:%d events:%llu syscalls:%llu(action:%llu io:%llu) syscalls/event:%.2f syscalls/msg:%.2f p50:%lluus p99:%lluus msgs/s:%.0f\n",
+		name,bench.completed,(unsigned long long)bench.events,(unsigned long long)syscalls,
+		(unsigned long long)bench.action_syscalls,(unsigned long long)bench.io_syscalls,
+		bench.events > 0 ? (double)syscalls / bench.events : 0.0,
+		bench.completed > 0 ? (double)syscalls / bench.completed : 0.0,
+		(unsigned long long)percentile(bench.samples,bench.samples_count,50)/1000,
+		(unsigned long long)percentile(bench.samples,bench.samples_count,99)/1000,
+		bench.used > 0 ? bench.completed * 1e9 / bench.used : 0.0);
+
+	cycle_destroy(&cycle);
+	close(listen_fd);
+	FREE(bench.peers);
+	FREE(bench.samples);
+	return 0;
+}
+
+int bench_action(int argc,char* argv[])
+{
+	int connections = 100;
+	int messages = 1000;
+	char * module = NULL;
+	GET_PARAM_INT(connections,2);
+	GET_PARAM_INT(messages,3);
+	GET_PARAM(module,4);
+
+	if(module != NULL)
+	{
+		action_bench_run(module,connections,messages);
+	}else{
+		const char * name;
+		for(int i = 0;(name = action_module_name(i)) != NULL;i++)
+		{
+			action_bench_run(name,connections,messages);
+		}
+	}
+	action_select(NULL);
+	return 0;
+}
+
+//mpsc: 1到N个生产者线程向同一个cycle投递消息,对比原来的 malloc+自旋锁 方式
+
+typedef struct mpsc_bench_s{
+	int mode;					//0:无锁队列 1:malloc+自旋锁
+	int messages;
+	volatile int start;
+	mpsc_queue_t queue;
+	ngx_queue_t locked;
+	ngx_atomic_t lock;
+	safe_event_t * nodes;
+}mpsc_bench_t;
+
+typedef struct mpsc_producer_s{
+	mpsc_bench_t * bench;
+	safe_event_t * nodes;
+	uv_thread_t thread;
+}mpsc_producer_t;
+
+static void mpsc_bench_producer(void *arg)
+{
+	mpsc_producer_t * producer = (mpsc_producer_t*)arg;
+	mpsc_bench_t * bench = producer->bench;
+	while(!bench->start)
+	{
+		ngx_cpu_pause();
+	}
+	for(int i = 0;i < bench->messages;i++)
+	{
+		if(bench->mode == 0)
+		{
+			mpsc_queue_push(&bench->queue,&producer->nodes[i].node);
+		}else{
+			event_t * ev = event_create(NULL,NULL);
+			ngx_spinlock(&bench->lock,1,0);
+			ngx_queue_insert_tail(&bench->locked,&ev->queue);
+			ngx_unlock(&bench->lock);
+		}
+	}
+}
+
+static int mpsc_bench_consume(mpsc_bench_t * bench)
+{
+	int count = 0;
+	if(bench->mode == 0)
+	{
+		mpsc_node_t * node = mpsc_queue_take(&bench->queue);
+		while(node != NULL)
+		{
+			node = node->next;
+			count++;
+		}
+	}else{
+		ngx_queue_t tmp;
+		ngx_queue_init(&tmp);
+		ngx_spinlock(&bench->lock,1,0);
+		ngx_queue_add(&tmp,&bench->locked);
+		ngx_queue_init(&bench->locked);
+		ngx_unlock(&bench->lock);
+		while(!ngx_queue_empty(&tmp))
+		{
+			ngx_queue_t * q = ngx_queue_head(&tmp);
+			ngx_queue_remove(q);
+			event_t * ev = ngx_queue_data(q,event_t,queue);
+			event_destroy(&ev);
+			count++;
+		}
+	}
+	return count;
+}
+
+static void mpsc_bench_run(int mode,int producers,int messages)
+{
+	mpsc_bench_t bench;
+	MEMZERO(&bench,sizeof(bench));
+	bench.mode = mode;
+	bench.messages = messages;
+	mpsc_queue_init(&bench.queue);
+	ngx_queue_init(&bench.locked);
+	bench.nodes = (safe_event_t*)MALLOC(sizeof(safe_event_t)*producers*messages);
+	mpsc_producer_t * list = (mpsc_producer_t*)MALLOC(sizeof(mpsc_producer_t)*producers);
+	for(int i = 0;i < producers;i++)
+	{
+		list[i].bench = &bench;
+		list[i].nodes = bench.nodes + i*messages;
+		ABORTI(uv_thread_create(&list[i].thread,mpsc_bench_producer,&list[i]) != 0);
+	}
+	int total = producers * messages;
+	int received = 0;
+	uint64_t begin = time_nanosecond();
+	bench.start = 1;
+	while(received < total)
+	{
+		received += mpsc_bench_consume(&bench);
+	}
+	uint64_t used = time_nanosecond() - begin;
+	for(int i = 0;i < producers;i++)
+	{
+		uv_thread_join(&list[i].thread);
+	}
+	LOGI("%-8s producers:%d msgs:%d msgs/s:%.0f\n",mode == 0 ? "mpsc" : "spinlock",
+		producers,received,used > 0 ? received * 1e9 / used : 0.0);
+	FREE(list);
+	FREE(bench.nodes);
+}
+
+int bench_mpsc(int argc,char* argv[])
+{
+	int producers = 4;
+	int messages = 1000000;
+	GET_PARAM_INT(producers,2);
+	GET_PARAM_INT(messages,3);
+	for(int n = 1;n <= producers;n *= 2)
+	{
+		mpsc_bench_run(0,n,messages);
+		mpsc_bench_run(1,n,messages);
+	}
+	return 0;
+}
+
+//timer: 同样的定时器负载分别跑在红黑树和时间轮上
+
+typedef struct timer_bench_s{
+	int wheel;
+	ngx_rbtree_t tree;
+	ngx_event_wheel_t * w;
+	int fired;
+}timer_bench_t;
+
+static void timer_bench_handler(event_t *ev)
+{
+	timer_bench_t * bench = (timer_bench_t*)ev->data;
+	bench->fired++;
+}
+
+static void timer_bench_add(timer_bench_t * bench,event_t *ev,ngx_msec_t timer)
+{
+	if(bench->wheel)
+		ngx_event_wheel_add(bench->w,ev,timer);
+	else
+		ngx_event_add_timer(&bench->tree,ev,timer);
+}
+
+static void timer_bench_del(timer_bench_t * bench,event_t *ev)
+{
+	if(bench->wheel)
+		ngx_event_wheel_del(bench->w,ev);
+	else
+		ngx_event_del_timer(&bench->tree,ev);
+}
+
+static double timer_bench_ns(uint64_t begin,int count)
+{
+	return count > 0 ? (double)(time_nanosecond() - begin) / count : 0.0;
+}
+
+static void timer_bench_run(int wheel,int count,int range)
+{
+	timer_bench_t bench;
+	MEMZERO(&bench,sizeof(bench));
+	bench.wheel = wheel;
+	ngx_event_timer_init(&bench.tree);
+	bench.w = (ngx_event_wheel_t*)MALLOC(sizeof(ngx_event_wheel_t));
+	ngx_msec_t base = ngx_current_msec;
+	ngx_event_wheel_init(bench.w);
+
+	event_t * events = (event_t*)MALLOC(sizeof(event_t)*count);
+	ngx_msec_t * timeouts = (ngx_msec_t*)MALLOC(sizeof(ngx_msec_t)*count);
+	uint32_t seed = 2463534242u;
+	for(int i = 0;i < count;i++)
+	{
+		event_init(&events[i],timer_bench_handler,&bench);
+		seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+		timeouts[i] = 1 + seed % range;
+	}
+
+	uint64_t begin = time_nanosecond();
+	for(int i = 0;i < count;i++)
+	{
+		timer_bench_add(&bench,&events[i],timeouts[i]);
+	}
+	double add = timer_bench_ns(begin,count);
+
+	//重新设置到另一个时间,模拟连接读写时刷新超时
+	begin = time_nanosecond();
+	for(int i = 0;i < count;i++)
+	{
+		timer_bench_add(&bench,&events[i],timeouts[count - 1 - i] + NGX_TIMER_LAZY_DELAY);
+	}
+	double readd = timer_bench_ns(begin,count);
+
+	begin = time_nanosecond();
+	for(int i = 0;i < count;i++)
+	{
+		timer_bench_del(&bench,&events[i]);
+	}
+	double del = timer_bench_ns(begin,count);
+
+	for(int i = 0;i < count;i++)
+	{
+		timer_bench_add(&bench,&events[i],timeouts[i]);
+	}
+	//逐毫秒推进时间,全部到期
+	begin = time_nanosecond();
+	for(int t = 0;t <= range;t++)
+	{
+		ngx_current_msec = base + t;
+		if(wheel)
+			ngx_event_wheel_expire(bench.w);
+		else
+			ngx_event_expire_timers(&bench.tree);
+	}
+	double expire = timer_bench_ns(begin,count);
+	ngx_current_msec = base;
+
+	LOGI("%-8s timers:%d add:%.1fns readd:%.1fns del:%.1fns expire:%.1fns fired:%d\n",
+		wheel ? "wheel" : "rbtree",count,add,readd,del,expire,bench.fired);
+	FREE(timeouts);
+	FREE(events);
+	FREE(bench.w);
+}
+
+int bench_timer(int argc,char* argv[])
+{
+	int count = 1000000;
+	int range = 60000;
+	GET_PARAM_INT(count,2);
+	GET_PARAM_INT(range,3);
+	timer_bench_run(0,count,range);
+	timer_bench_run(1,count,range);
+	return 0;
+}
+
+//ring: 同样的写入读出流量分别跑在loopqueue_t和mirrorqueue_t上
+//按不整除的块写入,读出时按固定长度取帧,统计每字节耗时和需要拆成两段的次数
+
+static void ring_bench_loopqueue(int size,int chunk,int frame,int64_t bytes,char * src,char * dst)
+{
+	loopqueue_t q;
+	queue_init(&q,size);
+	int64_t moved = 0;
+	int64_t split = 0;
+	uint64_t begin = time_nanosecond();
+	while(moved < bytes)
+	{
+		//写入一块,绕回时拆成两段
+		int left = chunk;
+		int count = 0;
+		while(left > 0 && queue_w(&q) != NULL)
+		{
+			int n = min(left,queue_wsize(&q));
+			memcpy(queue_w(&q),src,n);
+			queue_wpush(&q,n);
+			left -= n;
+			count++;
+		}
+		if(count > 1) split++;
+		//取出完整的帧,跨过绕回点的帧要拼起来
+		while(queue_used(&q) >= frame)
+		{
+			int n = min(frame,queue_rsize(&q));
+			memcpy(dst,queue_r(&q),n);
+			queue_rpush(&q,n);
+			if(n < frame)
+			{
+				memcpy(dst + n,queue_r(&q),frame - n);
+				queue_rpush(&q,frame - n);
+				split++;
+			}
+			moved += frame;
+		}
+	}
+	double ns = (double)(time_nanosecond() - begin) / bytes;
+	LOGI("%-10s size:%d chunk:%d frame:%d %.3fns/byte split:%lld\n","loopqueue",size,chunk,frame,ns,(long long)split);
+	queue_delete(&q);
+}
+
+static void ring_bench_mirrorqueue(int size,int chunk,int frame,int64_t bytes,char * src,char * dst)
+{
+	mirrorqueue_t q;
+	if(mirrorqueue_init(&q,size) != 0)
+	{
+		LOGI("%-10s not supported\n","mirror");
+		return;
+	}
+	int64_t moved = 0;
+	uint64_t begin = time_nanosecond();
+	while(moved < bytes)
+	{
+		int n = min(chunk,(int)mirrorqueue_wsize(&q));
+		memcpy(mirrorqueue_w(&q),src,n);
+		mirrorqueue_wpush(&q,n);
+		while(mirrorqueue_used(&q) >= (uint32_t)frame)
+		{
+			memcpy(dst,mirrorqueue_r(&q),frame);
+			mirrorqueue_rpush(&q,frame);
+			moved += frame;
+		}
+	}
+	double ns = (double)(time_nanosecond() - begin) / bytes;
+	LOGI("%-10s size:%u chunk:%d frame:%d %.3fns/byte split:0\n","mirror",q.size,chunk,frame,ns);
+	mirrorqueue_done(&q);
+}
+
+int bench_ring(int argc,char* argv[])
+{
+	int size = 64*1024;
+	int chunk = 1500;
+	int frame = 700;
+	int mb = 1024;
+	GET_PARAM_INT(size,2);
+	GET_PARAM_INT(chunk,3);
+	GET_PARAM_INT(frame,4);
+	GET_PARAM_INT(mb,5);
+	if(chunk <= 0 || frame <= 0 || frame > size || chunk > size)
+	{
+		LOGE("invalid ring param size:%d chunk:%d frame:%d\n",size,chunk,frame);
+		return -1;
+	}
+	char * src = (char*)MALLOC(chunk);
+	char * dst = (char*)MALLOC(frame);
+	MEMSET(src,'r',chunk);
+	ring_bench_loopqueue(size,chunk,frame,(int64_t)mb*1024*1024,src,dst);
+	ring_bench_mirrorqueue(size,chunk,frame,(int64_t)mb*1024*1024,src,dst);
+	FREE(dst);
+	FREE(src);
+	return 0;
+}
+
+//frame: 同样的帧流按echo的方式整段搬运,或者解码成帧逐个取出,统计每秒帧数
+//输入按chunk写入接收队列模拟socket读;echo把队列里的数据全部拷出,分帧时每帧拷出一次模拟发送
+
+#define FRAME_BENCH_QUEUE (64*1024)
+
+static int frame_bench_handler(void * data,const uint8_t * frame,uint32_t len)
+{
+	memcpy(data,frame,len);
+	return 0;
+}
+
+//从循环的帧流中写入最多chunk字节
+static void frame_bench_fill(loopqueue_t * q,const uint8_t * stream,int period,int * pos,int chunk)
+{
+	while(chunk > 0 && queue_w(q) != NULL)
+	{
+		int n = min(min(chunk,queue_wsize(q)),period - *pos);
+		memcpy(queue_w(q),stream + *pos,n);
+		queue_wpush(q,n);
+		chunk -= n;
+		*pos = (*pos + n) % period;
+	}
+}
+
+static void frame_bench_run(int prefix,int frame,int chunk,int64_t bytes)
+{
+	uint8_t head[FRAME_PREFIX_MAX];
+	int n = frame_prefix_encode(prefix,frame,head);
+	if(n < 0)
+	{
+		LOGI("%-6s prefix:%d frame:%d not supported\n","frame",prefix,frame);
+		return;
+	}
+	//帧流的一个周期至少和队列一样长,绕回点落在不同位置
+	int count = FRAME_BENCH_QUEUE / (n + frame) + 1;
+	int period = count * (n + frame);
+	uint8_t * stream = (uint8_t*)MALLOC(period);
+	uint8_t * dst = (uint8_t*)MALLOC(FRAME_BENCH_QUEUE);
+	for(int i = 0;i < count;i++)
+	{
+		memcpy(stream + i * (n + frame),head,n);
+		MEMSET(stream + i * (n + frame) + n,'f',frame);
+	}
+	loopqueue_t q;
+	int pos = 0;
+	int64_t moved = 0;
+	queue_init(&q,FRAME_BENCH_QUEUE);
+	uint64_t begin = time_nanosecond();
+	while(moved < bytes)
+	{
+		frame_bench_fill(&q,stream,period,&pos,chunk);
+		while(queue_used(&q) > 0)
+		{
+			int k = queue_rsize(&q);
+			memcpy(dst,queue_r(&q),k);
+			queue_rpush(&q,k);
+			moved += k;
+		}
+	}
+	double echo_ns = (double)(time_nanosecond() - begin);
+	queue_delete(&q);
+
+	frame_decoder_t f;
+	frame_decoder_init(&f,prefix,frame);
+	pos = 0;
+	queue_init(&q,FRAME_BENCH_QUEUE);
+	begin = time_nanosecond();
+	while((int64_t)f.frames * (n + frame) < bytes)
+	{
+		frame_bench_fill(&q,stream,period,&pos,chunk);
+		frame_decode(&f,&q,frame_bench_handler,dst);
+	}
+	double frame_ns = (double)(time_nanosecond() - begin);
+	double frames = (double)bytes / (n + frame);
+	LOGI("frame:%-6d prefix:%d echo %8.2fMframes/s decode %8.2fMframes/s %6.0fMB/s copied:%.2f%%\n",
+		frame,n,frames * 1000 / echo_ns,frames * 1000 / frame_ns,
+		(double)bytes * 1000 / frame_ns,(double)f.copied * 100 / f.frames);
+	frame_decoder_done(&f);
+	queue_delete(&q);
+	FREE(dst);
+	FREE(stream);
+}
+
+int bench_frame(int argc,char* argv[])
+{
+	int mb = 512;
+	int chunk = 16*1024;
+	int prefix = FRAME_PREFIX_VARINT;
+	GET_PARAM_INT(mb,2);
+	GET_PARAM_INT(chunk,3);
+	GET_PARAM_INT(prefix,4);
+	if(chunk <= 0 || chunk > FRAME_BENCH_QUEUE)
+	{
+		LOGE("invalid frame param chunk:%d\n",chunk);
+		return -1;
+	}
+	static const int sizes[] = {16,64,256,1024,4096,16384};
+	for(int i = 0;i < (int)(sizeof(sizes) / sizeof(sizes[0]));i++)
+	{
+		frame_bench_run(prefix,sizes[i],chunk,(int64_t)mb*1024*1024);
+	}
+	return 0;
+}
+
+typedef struct bench_s{
+	const char * name;
+	int (*run)(int argc,char* argv[]);
+	const char * usage;
+}bench_t;
+
+static bench_t g_bench[] = {
+	{"action",bench_action,"action [connections] [messages] [module]"},
+	{"mpsc",bench_mpsc,"mpsc [producers] [messages]"},
+	{"timer",bench_timer,"timer [count] [range_ms]"},
+	{"ring",bench_ring,"ring [size] [chunk] [frame] [MB]"},
+	{"frame",bench_frame,"frame [MB] [chunk] [prefix 0=varint|1|2|4]"},
+	{NULL,NULL,NULL}
+};
+
+int main(int argc,char* argv[])
+{
+	os_init();
+	socket_init();
+	ngx_time_init();
+
+	char * name = NULL;
+	GET_PARAM(name,1);
+	for(int i = 0;g_bench[i].name != NULL;i++)
+	{
+		if(name == NULL || strcmp(name,g_bench[i].name) == 0)
+		{
+			g_bench[i].run(argc,argv);
+			if(name != NULL) return 0;
+		}
+	}
+	if(name != NULL)
+	{
+		LOGI("usage:\n");
+		for(int i = 0;g_bench[i].name != NULL;i++)
+		{
+			LOGI("  %s %s\n",argv[0],g_bench[i].usage);
+		}
+		return -1;
+	}
+	return 0;
+}
@@ -1,6 +1,7 @@
 #include "Module/module.h"
 #include "Module/slave.h"
 #include "Function/echo.h"
+#include "Function/output.h"
 #include "Function/signal.h"
 #include "Function/service.h"
 
@@ -10,7 +11,12 @@ void heartbeat_event_handler(event_t *ev)
 	char byte[65535];
 	int len = 10;
 	connection_t *c = (connection_t*)ev->data;
-	int ret = buffer_write(c,byte,len);
+	//先发出上次积压的,本轮的心跳在step阶段和其他输出一起发
+	int ret = connection_flush(c);
+	if(ret != -1)
+	{
+		ret = connection_write(c,byte,len);
+	}
 	if(ret != -1)
 	{
 		timer_add(c->cycle,c->so.write,1000);
@@ -46,15 +52,20 @@ void discard_read_event_handler(event_t *ev)
 void control_init(connection_t * c)
 {
 	ASSERT(c != NULL);
-	c->so.write = event_create(heartbeat_event_handler,c);
-	c->so.read = event_create(discard_read_event_handler,c);
-	c->so.error = event_create(connection_error_handle,c);
+	event_init(c->so.write,heartbeat_event_handler,c);
+	event_init(c->so.read,discard_read_event_handler,c);
+	event_init(c->so.error,connection_error_handle,c);
 }
 
 #define MAX_FD_COUNT 1024*1024
 char * url = "127.0.0.1:888";
 int blocking = 0;
 int max_connection_count = 0;
+char * event_module = NULL;
+//tcp: 连接后定时发心跳; udp: max_connection_count个UDP端点,每个保持window个数据报在途
+char * mode = "tcp";
+int udp_size = 64;
+int udp_window = 256;
 
 #define GET_PARAM(PARAM,I)	if(argc >= I+1) PARAM = argv[I];
 #define GET_PARAM_INT(PARAM,I)	if(argc >= I+1) PARAM = atoi(argv[I]);
@@ -99,6 +110,99 @@ void cycle_handler(event_t *ev)
 	event_add(cycle,ev);
 }
 
+typedef struct udp_load_s{
+	event_t ev;					//每秒统计,窗口全部丢失时重新填满
+	connection_datagram_t * d;
+	int inflight;
+	uint64_t rx;				//上次统计时的收发数
+	uint64_t tx;
+	char payload[DATAGRAM_SIZE];
+}udp_load_t;
+
+static void udp_load_fill(udp_load_t * load)
+{
+	while(load->inflight < udp_window)
+	{
+		if(datagram_send(load->d,NULL,0,load->payload,udp_size,0) != 0)
+		{
+			break;
+		}
+		load->inflight++;
+	}
+}
+
+//收到多少发多少,在途数保持在窗口大小,读事件处理完后统一发出
+void udp_load_handler(connection_datagram_t * d,datagram_msg_t * msgs,int count)
+{
+	udp_load_t * load = (udp_load_t*)d->data;
+	for(int i = 0;i < count;i++)
+	{
+		load->inflight -= datagram_segments(&msgs[i]);
+	}
+	if(load->inflight < 0) load->inflight = 0;
+	udp_load_fill(load);
+}
+
+void udp_load_event_handler(event_t *ev)
+{
+	udp_load_t * load = (udp_load_t*)ev->data;
+	connection_datagram_t * d = load->d;
+	LOGI("udp %d rx:%llu/s tx:%llu/s inflight:%d dropped:%llu\n",d->c->so.handle,
+		(unsigned long long)(d->rx - load->rx),(unsigned long long)(d->tx - load->tx),
+		load->inflight,(unsigned long long)d->dropped);
+	if(d->rx == load->rx)
+	{
+		//一秒没有回应,认为在途的都丢了
+		load->inflight = 0;
+		udp_load_fill(load);
+		datagram_flush(d);
+	}
+	load->rx = d->rx;
+	load->tx = d->tx;
+	timer_add(d->c->cycle,ev,1000);
+}
+
+//端点随cycle结束,统计结构跟着连接内存池释放
+void udp_load_cleanup(void * data)
+{
+	udp_load_t * load = (udp_load_t*)data;
+	timer_del(load->d->c->cycle,&load->ev);
+	FREE(load);
+}
+
+void udp_load_init(cycle_t *cycle)
+{
+	int count = max_connection_count > 0 ? max_connection_count : 1;
+	if(udp_size <= 0 || udp_size > DATAGRAM_SIZE) udp_size = DATAGRAM_SIZE;
+	for(int i = 0;i < count;i++)
+	{
+		SOCKET fd = socket_connect("udp",url,1);
+		if(fd == -1)
+		{
+			LOGE("udp connect %s errno:%d\n",url,_ERRNO);
+			return;
+		}
+		udp_load_t * load = (udp_load_t*)MALLOC(sizeof(udp_load_t));
+		MEMZERO(load,sizeof(udp_load_t));
+		load->d = datagram_create(cycle,fd,udp_load_handler,load);
+		if(load->d == NULL)
+		{
+			FREE(load);
+			return;
+		}
+		ngx_pool_cleanup_t * cln = ngx_pool_cleanup_add(connection_pool(load->d->c),0);
+		if(cln != NULL)
+		{
+			cln->handler = udp_load_cleanup;
+			cln->data = load;
+		}
+		event_init(&load->ev,udp_load_event_handler,load);
+		timer_add(cycle,&load->ev,1000);
+		udp_load_fill(load);
+		datagram_flush(load->d);
+	}
+}
+
 void print()
 {
 	LOGD("ngx_rbtree_node_t:%d\n",sizeof(ngx_rbtree_node_t));
@@ -118,6 +222,14 @@ int main(int argc,char* argv[])
 	GET_PARAM(url,1);
 	GET_PARAM_INT(blocking,2);
 	GET_PARAM_INT(max_connection_count,3);
+	GET_PARAM(event_module,4);
+	GET_PARAM(mode,5);
+	GET_PARAM_INT(udp_size,6);
+	GET_PARAM_INT(udp_window,7);
+	if(action_select(event_module) != 0)
+	{
+		return -1;
+	}
 
 	os_init();
 	socket_init();
@@ -128,8 +240,14 @@ int main(int argc,char* argv[])
 	ABORTI(cycle->core == NULL);
 	signal_init(cycle);
 
-	event_t *process = event_create(cycle_handler,cycle);
-	event_add(cycle,process);
+	event_t *process = NULL;
+	if(strcmp(mode,"udp") == 0)
+	{
+		udp_load_init(cycle);
+	}else{
+		process = event_create(cycle_handler,cycle);
+		event_add(cycle,process);
+	}
 	cycle_process(cycle);
 	event_destroy(&process);
 	cycle_destroy(&cycle);
@@ -5,62 +5,121 @@
 #include "Function/service.h"
 
 #define MAX_FD_COUNT 1024*1024
+char * event_module = NULL;
+//master: 主线程accept后分发给slave; reuseport: 每个线程各自监听和accept
+char * accept_mode = "master";
+int accept_reuseport = 0;
+//master模式下的分发策略: rr least p2c busy
+char * dispatch = NULL;
+//连接上的服务: echo splice zerocopy frame,udp为UDP端点上的echo
+char * service = NULL;
+//每次可读事件最多accept的连接数,用完后下一轮继续
+int accept_budget = 1000;
+char * listen_addr = "0.0.0.0:888";
+socket_listen_conf_t listen_conf;
+
+#define GET_PARAM(PARAM,I)	if(argc >= I+1) PARAM = argv[I];
 
 int cycle_thread_post(cycle_t *cycle,SOCKET fd);
+void cycle_thread_flush(cycle_t *cycle);
 
 void accept_event_handler(event_t *ev)
 {
 	connection_t *c = (connection_t*)ev->data;
 	int count = 0;
-	// while(1)
+	//边缘触发下要accept到EAGAIN为止
+	while(1)
 	{
 		struct sockaddr_in addr;
 		socklen_t len = sizeof(struct sockaddr_in);
-		// LOGD("accept %d ...\n",c->so.handle);
-		SOCKET afd = accept(c->so.handle,(struct sockaddr*)&addr,&len);
+		//写满时依赖 EWOULDBLOCK 切换到等待可写事件,accept4直接返回非阻塞的socket
+		SOCKET afd = socket_accept(c->so.handle,(struct sockaddr*)&addr,&len);
 		if(afd == -1)
 		{
-			if(count == 0)
+			if(_ERRNO == _ERROR(EWOULDBLOCK))
+			{
+				ev->ready = 0;
+			}
+			else if(count == 0)
 			{
 				LOGE("accept errno:%d\n",_ERRNO);
 			}
-			return;
+			break;
 		}
-		// socket_nonblocking(afd);
 		cycle_thread_post(c->cycle,afd);
 		count++;
-		if(count >= 1000)
+		if(count >= accept_budget)
 		{
-			return;
+			//本轮额度用完,下一轮继续
+			if(!event_is_add(c->cycle,ev))
+				event_add(c->cycle,ev);
+			break;
 		}
 	}
+	//本批连接按slave合并,每个slave投递一次
+	cycle_thread_flush(c->cycle);
 }
 
-void accept_handler(event_t *ev)
+//UDP端点的接收缓冲区,突发时内核里多缓存一些,实际大小受rmem_max限制
+#define DATAGRAM_RECVBUF (4*1024*1024)
+
+//数据报服务没有accept,reuseport模式下每个线程各自bind,内核按四元组分散到各线程
+void datagram_listen(cycle_t *cycle,datagram_handler_pt handler)
 {
-	cycle_t *cycle = (cycle_t*)ev->data;
-	event_destroy(&ev);
-	SOCKET fd = socket_bind("tcp","0.0.0.0:888");
+	SOCKET fd = socket_bind_("udp",listen_addr,accept_reuseport);
 	if(fd == -1){
 		return ;
 	}
-	int ret = listen(fd,MAX_FD_COUNT);
-	if(ret == -1)
+	socket_nonblocking(fd);
+	if(socket_recvbuf(fd,DATAGRAM_RECVBUF) != 0)
 	{
-		LOGE("listen errno:%d\n",_ERRNO);
-		close(fd);
-		return ;
+		LOGE("recvbuf (%s) errno:%d\n",listen_addr,_ERRNO);
 	}
+	connection_datagram_t * d = datagram_create(cycle,fd,handler,NULL);
+	ASSERTIF(d != NULL,"datagram_create %s\n",listen_addr);
+	if(d != NULL)
+	{
+		LOGI("datagram %s gro:%d gso:%d\n",listen_addr,d->gro,d->gso);
+	}
+}
 
+void accept_listen(cycle_t *cycle)
+{
+	if(service_datagram() != NULL)
+	{
+		datagram_listen(cycle,service_datagram());
+		return;
+	}
+	SOCKET fd = socket_listen("tcp",listen_addr,&listen_conf);
+	if(fd == -1){
+		return ;
+	}
 	socket_nonblocking(fd);
 	connection_t *conn = connection_create(cycle,fd);
-	conn->so.read = event_create(accept_event_handler,conn);
+	event_init(conn->so.read,accept_event_handler,conn);
 	conn->so.write = NULL;
-	conn->so.error = event_create(connection_error_handle,conn);
-	ret = connection_cycle_add(conn);
+	event_init(conn->so.error,connection_error_handle,conn);
+#ifdef NGX_FLAGS_ET
+	int ret = connection_cycle_add_(conn,NGX_READ_EVENT,NGX_FLAGS_ET);
+#else
+	int ret = connection_cycle_add(conn);
+#endif
 	ASSERTIF(ret == 0,"action_add %d errno:%d\n",ret,errno);
 }
 
+void accept_handler(event_t *ev)
+{
+	cycle_t *cycle = (cycle_t*)ev->data;
+	event_destroy(&ev);
+	accept_listen(cycle);
+}
+
+void slave_accept_handler(cycle_t * cycle,safe_event_t *sev)
+{
+	FREE(sev);
+	accept_listen(cycle);
+}
+
 void accept_connection(connection_t *conn)
 {
 	ASSERT(conn != NULL);
@@ -81,52 +140,170 @@ void connection_add_event(event_t *ev)
 {
 	connection_t * conn = (connection_t*)ev->data;
 	accept_connection(conn);
-	event_destroy(&ev);
 }
 
-void slave_connection_add_event(cycle_t * cycle,event_t *ev)
+//一批连接用第一个连接的queue串起来,只投递第一个连接的post
+void slave_connection_add_event(cycle_t * cycle,safe_event_t *sev)
 {
-	SOCKET fd = (SOCKET)ev->data;
-	connection_t * conn = connection_create(cycle,fd);
-	accept_connection(conn);
-	event_destroy(&ev);
+	connection_t * head = (connection_t*)sev->data;
+	ASSERT(head->cycle == cycle);
+	int count = 1;
+	while(!ngx_queue_empty(&head->queue))
+	{
+		ngx_queue_t * q = ngx_queue_head(&head->queue);
+		connection_t * conn = ngx_queue_data(q,connection_t,queue);
+		ngx_queue_remove(q);
+		ngx_queue_init(q);
+		ASSERT(conn->cycle == cycle);
+		accept_connection(conn);
+		count++;
+	}
+	accept_connection(head);
+	//分发时每个连接都计入了积压,这里减掉count个;消息本身的一个由safe_add_event计入,safe_process_event减掉
+	cycle->load.connections = cycle->connection_count;
+	ngx_atomic_fetch_add(&cycle->load.backlog,-count);
 }
 
+//主线程按slave暂存的本批连接,下标和slave_next_index一致
+static connection_t ** g_accept_batch = NULL;
+
 int cycle_thread_post(cycle_t *cycle,SOCKET fd)
 {
-	if(cycle->data == NULL)
+	//reuseport模式下连接留在accept的线程
+	if(cycle->data == NULL || accept_reuseport)
 	{
-		event_add(cycle,event_create(connection_add_event,connection_create(cycle,fd)));
+		//event_add 是宏,参数会被多次求值
+		connection_t * conn = connection_create(cycle,fd);
+		event_init(conn->so.read,connection_add_event,conn);
+		event_add(cycle,conn->so.read);
 	}else{
 		cycle_slave_t * slave = cycle->data;
-		cycle_t * slave_cycle = slave_next_cycle(slave);
-		ASSERT(slave_cycle != NULL);
-		safe_add_event(slave_cycle,event_create(NULL,(void*)fd),slave_connection_add_event);
+		int index = slave_next_index(slave);
+		cycle_t * target = slave_cycle(slave,index);
+		ASSERT(target != NULL);
+		//连接对象从主线程的对象池分配,由slave线程接管,释放时还回主线程
+		connection_t * conn = connection_create_(cycle,target,fd);
+		//先计入积压,同一批里后面的分发能看到
+		ngx_atomic_fetch_add(&target->load.backlog,1);
+		if(g_accept_batch[index] == NULL)
+		{
+			g_accept_batch[index] = conn;
+		}else{
+			ngx_queue_insert_tail(&g_accept_batch[index]->queue,&conn->queue);
+		}
 	}
 	return 0;
 }
 
+void cycle_thread_flush(cycle_t *cycle)
+{
+	if(cycle->data == NULL || accept_reuseport)
+	{
+		return;
+	}
+	cycle_slave_t * slave = cycle->data;
+	for(int i = 0;i < slave->max_cycle_count;i++)
+	{
+		connection_t * head = g_accept_batch[i];
+		if(head != NULL)
+		{
+			g_accept_batch[i] = NULL;
+			head->post.handler = slave_connection_add_event;
+			safe_add_event(head->cycle,&head->post);
+		}
+	}
+}
+
 typedef struct statistics_s{
 	event_t ev;
 	ngx_msec_t time;
 	cycle_t * cycle;
+#if defined(NGX_MEM_STAT)
+	uint64_t allocs[MEM_TAG_COUNT];		//上次统计时的分配次数,用来算分配速率
+#endif
 }statistics_t;
 
+#if defined(NGX_MEM_STAT)
+//主线程汇总全部线程各模块的内存
+void statistics_memory(statistics_t *st)
+{
+	mem_stat_t total;
+	int threads = mem_stat_snapshot(NULL,0,&total);
+	ngx_msec_t elapsed = ngx_current_msec - st->time;
+	int64_t bytes = 0;
+	for(int i = 0;i < MEM_TAG_COUNT;i++)
+	{
+		bytes += total.tags[i].bytes;
+	}
+	LOGD("memory threads:%d bytes:%lld\n",threads,(long long)bytes);
+	for(int i = 0;i < MEM_TAG_COUNT;i++)
+	{
+		mem_tag_stat_t *t = &total.tags[i];
+		uint64_t rate = elapsed > 0 ? (t->allocs - st->allocs[i]) * 1000 / elapsed : 0;
+		LOGD("  %-10s bytes:%lld peak:%lld live:%lld alloc/s:%llu\n",mem_tag_name(i),
+			(long long)t->bytes,(long long)t->peak,
+			(long long)(t->allocs - t->frees),(unsigned long long)rate);
+		st->allocs[i] = t->allocs;
+	}
+	st->time = ngx_current_msec;
+}
+#endif
+
+//主线程汇总全部cycle的循环耗时
+void statistics_cycle_stat(cycle_t *cycle)
+{
+	cycle_stat_t total;
+	MEMZERO(&total,sizeof(total));
+	int count = 0;
+	cycle_stat_t stat;
+	if(cycle_stat_snapshot(&cycle->stat,&stat) == 0)
+	{
+		cycle_stat_merge(&total,&stat);
+		count++;
+	}
+	if(cycle->data != NULL)
+	{
+		count += slave_stat_snapshot((cycle_slave_t*)cycle->data,&total);
+	}
+	LOGD("cycles:%d ticks:%llu events p50:%llu p99:%llu lag p99:%lluus\n",count,
+		(unsigned long long)total.ticks,
+		(unsigned long long)stat_histogram_percentile(&total.events,50),
+		(unsigned long long)stat_histogram_percentile(&total.events,99),
+		(unsigned long long)stat_histogram_percentile(&total.lag,99)/1000);
+	for(int i = 0;i < CYCLE_PHASE_COUNT;i++)
+	{
+		stat_histogram_t *h = &total.phase[i];
+		LOGD("  %-8s p50:%lluus p99:%lluus max:%lluus\n",cycle_phase_name(i),
+			(unsigned long long)stat_histogram_percentile(h,50)/1000,
+			(unsigned long long)stat_histogram_percentile(h,99)/1000,
+			(unsigned long long)h->max/1000);
+	}
+}
+
 void statistics_event_handler(event_t *ev)
 {
 	statistics_t * st = (statistics_t*)ev->data;
 	cycle_t *cycle = st->cycle;
-	LOGD("%p %d %d\n",cycle,cycle->index,cycle->connection_count);
-	timer_add(cycle,&st->ev,5*1000);
+	if(cycle->master)
+	{
+		statistics_cycle_stat(cycle);
+#if defined(NGX_MEM_STAT)
+		statistics_memory(st);
+#endif
+	}
+	LOGD("%p %d %d backlog:%d busy:%d\n",cycle,cycle->index,cycle->connection_count,
+		(int)cycle->load.backlog,(int)cycle->load.busy);
+	timer_add_precise(cycle,&st->ev,5*1000);
 }
 
 void func_cycle_init(struct cycle_s* cycle)
 {
 	statistics_t * st = (statistics_t*)MALLOC(sizeof(statistics_t));
+	MEMZERO(st,sizeof(statistics_t));
 	st->time = ngx_current_msec;
 	st->cycle = cycle;
 	event_init(&st->ev, statistics_event_handler, st);
-	timer_add(cycle,&st->ev,1000);
+	timer_add_precise(cycle,&st->ev,1000);
 }
 
 void func_cycle_step(struct cycle_s* cycle)
@@ -178,6 +355,33 @@ int main(int argc,char* argv[])
 {
 	print();
 
+	GET_PARAM(event_module,1);
+	if(action_select(event_module) != 0)
+	{
+		return -1;
+	}
+	GET_PARAM(accept_mode,2);
+	if(strcmp(accept_mode,"reuseport") == 0)
+	{
+		accept_reuseport = 1;
+	}else if(strcmp(accept_mode,"master") != 0)
+	{
+		LOGE("unknown accept mode:%s\n",accept_mode);
+		return -1;
+	}
+	GET_PARAM(dispatch,3);
+	GET_PARAM(service,4);
+	if(service_select(service) != 0)
+	{
+		return -1;
+	}
+	if(argc >= 6) accept_budget = max(1,atoi(argv[5]));
+	GET_PARAM(listen_addr,6);
+	socket_listen_conf_init(&listen_conf);
+	listen_conf.backlog = MAX_FD_COUNT;
+	listen_conf.reuseport = accept_reuseport;
+	service_listen_conf(&listen_conf);
+
 	os_init();
 	socket_init();
 	ngx_time_init();
@@ -185,14 +389,35 @@ int main(int argc,char* argv[])
 	cycle_t *cycle = cycle_create(MAX_FD_COUNT,&g_ptr);
 	ABORTI(cycle == NULL);
 	ABORTI(cycle->core == NULL);
+	LOGI("event module:%s accept mode:%s service:%s\n",action_name(cycle->core),accept_mode,service_name());
 	cycle->index = 0;
 	int max_thread_count = (ngx_ncpu - 1)*2;
 	if(max_thread_count > 0)
 	{
-		cycle->data = slave_create(MAX_FD_COUNT,max_thread_count,&g_ptr);
+		cycle_slave_t * slave = slave_create(MAX_FD_COUNT,max_thread_count,&g_ptr);
+		cycle->data = slave;
+		g_accept_batch = (connection_t**)MALLOC_TAG(MEM_TAG_CYCLE,sizeof(connection_t*) * max_thread_count);
+		MEMZERO(g_accept_batch,sizeof(connection_t*) * max_thread_count);
+		if(slave_dispatch_select(slave,dispatch) != 0)
+		{
+			return -1;
+		}
 	}
 	signal_init(cycle);
 
+	if(accept_reuseport && cycle->data != NULL)
+	{
+		//每个slave在自己的线程里打开监听
+		cycle_slave_t * slave = (cycle_slave_t*)cycle->data;
+		slave_start(slave);
+		for(int i = 0 ; i < slave->max_cycle_count;i++)
+		{
+			safe_event_t * sev = (safe_event_t*)MALLOC_TAG(MEM_TAG_MESSAGE,sizeof(safe_event_t));
+			safe_event_init(sev,slave_accept_handler,NULL);
+			safe_add_event(slave_cycle(slave,i),sev);
+		}
+	}
+	//主线程同样监听,reuseport模式下也参与accept
 	event_t *process = event_create(accept_handler,cycle);
 	event_add(cycle,process);
 	cycle_process(cycle);
@@ -202,6 +427,8 @@ int main(int argc,char* argv[])
 		cycle_slave_t * slave = (cycle_slave_t*)cycle->data;
 		slave_destroy(&slave);
 		cycle->data = NULL;
+		FREE(g_accept_batch);
+		g_accept_batch = NULL;
 	}
 	cycle_destroy(&cycle);
 	return 0;